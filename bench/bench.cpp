@@ -22,6 +22,7 @@ const char *sorts[] = {
 	"stablesort",
 	"cxcrumsort",
 	"cxquadsort",
+	"cxstrsort",
 	"crumsort",
 	"quadsort",
 	"blitsort",
@@ -40,7 +41,9 @@ const char *sorts[] = {
 //#define SKIP_LONGS
 
 #include <crumsort.hpp>
+#include <huge_page_allocator.hpp>
 #include <quadsort.hpp>
+#include <string_sort.hpp>
 
 #define BLITSORT_H
 #define CRUMSORT_H
@@ -58,6 +61,8 @@ extern "C" void rhsort32(int* array, size_t n);
 #include <pdqsort.h>
 #include <timsort.hpp>
 #include <algorithm>
+#include <thread>
+#include <vector>
 
 #if USE_X86SIMDSORT
 #include <x86simdsort-static-incl.h>
@@ -296,6 +301,9 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 #ifdef SCANDUM_QUADSORT_HPP
 				case 'c' + 'x' * 32 + 'q' * 1024: if (size == sizeof(int)) scandum::quadsort(pta, pta + max); else if (size == sizeof(long long)) scandum::quadsort(ptla, ptla + max); else scandum::quadsort(ptda, ptda + max); break;
 #endif
+#ifdef SCANDUM_STRING_SORT_HPP
+				case 'c' + 'x' * 32 + 's' * 1024: if (cmpf == cmp_str) scandum::string_sort((const char **) array, (const char **) array + max); else return; break;
+#endif
 #ifdef X86_SIMD_SORT_STATIC_METHODS
 				case 's' + 'i' * 32 + 'm' * 1024: if (size == sizeof(int)) avx2_qsort(pta, max); else if (size == sizeof(long long)) avx2_qsort(ptla, max); else avx2_qsort(ptda, max, true); break;
 #endif
@@ -751,6 +759,340 @@ void range_test(int max, int samples, int repetitions, int seed)
 	return;
 }
 
+// sorts the same random integers over and over on one or more threads, with and without the
+// per-thread scratch arena, to show what allocating scratch memory on every call costs
+
+template<typename SORT>
+uint64_t arena_loop(int max, int loops, int threads, size_t limit, SORT sort)
+{
+	std::vector<std::thread> workers;
+	std::vector<uint64_t> times(threads);
+
+	for (int thread = 0 ; thread < threads ; thread++)
+	{
+		workers.emplace_back([=, &times]()
+		{
+			std::vector<int> unsorted(max), array(max);
+			unsigned int seed = thread + 1;
+
+			for (int cnt = 0 ; cnt < max ; cnt++)
+			{
+				seed = seed * 1103515245 + 12345;
+				unsorted[cnt] = seed >> 1;
+			}
+			scandum::set_scratch_arena_limit(limit);
+
+			uint64_t start = utime();
+
+			for (int loop = 0 ; loop < loops ; loop++)
+			{
+				array = unsorted;
+				sort(array.begin(), array.end());
+			}
+			times[thread] = utime() - start;
+
+			scandum::set_scratch_arena_limit(0);
+		});
+	}
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	return *std::max_element(times.begin(), times.end());
+}
+
+void arena_test(int max, int loops, int threads)
+{
+	size_t limit = scandum::quadsort_scratch_size<int>(max) * 2;
+	int thread_counts[] = { 1, threads };
+
+	printf("Arena benchmark: array size: %d, loops: %d, arena limit: %zu bytes\n\n", max, loops, limit);
+
+	printf("%s\n", "|      Name |    Items | Threads | Arena |   Total ms |  ns / sort |");
+	printf("%s\n", "| --------- | -------- | ------- | ----- | ---------- | ---------- |");
+
+	for (int threads : thread_counts)
+	{
+		for (size_t arena : { (size_t) 0, limit })
+		{
+			uint64_t crum = arena_loop(max, loops, threads, arena, [](auto begin, auto end) { scandum::crumsort(begin, end); });
+			uint64_t quad = arena_loop(max, loops, threads, arena, [](auto begin, auto end) { scandum::quadsort(begin, end); });
+
+			printf("|%10s | %8d | %7d | %5s | %10.3f | %10llu |\n", "cxcrumsort", max, threads, arena ? "on" : "off", crum / 1e6, (unsigned long long) (crum / loops));
+			printf("|%10s | %8d | %7d | %5s | %10.3f | %10llu |\n", "cxquadsort", max, threads, arena ? "on" : "off", quad / 1e6, (unsigned long long) (quad / loops));
+		}
+		if (threads == 1 && thread_counts[1] == 1)
+		{
+			break;
+		}
+	}
+}
+
+// sorts the same random 64 bit integers over and over with quadsort, whose scratch memory is as
+// large as the array, taking the scratch memory from the heap and from huge page backed mappings
+
+template<typename SORT>
+uint64_t hugepage_loop(int max, int loops, SORT sort)
+{
+	std::vector<long long> unsorted(max), array(max);
+	unsigned long long seed = 1;
+	uint64_t best = 0;
+
+	for (int cnt = 0 ; cnt < max ; cnt++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		unsorted[cnt] = (long long) (seed >> 1);
+	}
+
+	for (int loop = 0 ; loop < loops ; loop++)
+	{
+		array = unsorted;
+
+		uint64_t start = utime();
+
+		sort(array.begin(), array.end());
+
+		uint64_t time = utime() - start;
+
+		if (loop == 0 || time < best)
+		{
+			best = time;
+		}
+	}
+	return best;
+}
+
+void hugepage_test(int max, int loops)
+{
+	printf("Huge page benchmark: array size: %d, loops: %d, scratch memory: %zu bytes\n\n", max, loops, max * sizeof(long long));
+
+	printf("%s\n", "|      Name |    Items | Scratch memory |   Best ms |");
+	printf("%s\n", "| --------- | -------- | -------------- | --------- |");
+
+	uint64_t heap = hugepage_loop(max, loops, [](auto begin, auto end) { scandum::quadsort(begin, end); });
+	uint64_t transparent = hugepage_loop(max, loops, [](auto begin, auto end) { scandum::quadsort(begin, end, std::less<long long>(), scandum::huge_page_allocator<long long>()); });
+	uint64_t reserved = hugepage_loop(max, loops, [](auto begin, auto end) { scandum::quadsort(begin, end, std::less<long long>(), scandum::huge_page_allocator<long long>(true)); });
+
+	printf("|%10s | %8d | %14s | %9.3f |\n", "cxquadsort", max, "heap", heap / 1e6);
+	printf("|%10s | %8d | %14s | %9.3f |\n", "cxquadsort", max, "transparent", transparent / 1e6);
+	printf("|%10s | %8d | %14s | %9.3f |\n", "cxquadsort", max, "reserved", reserved / 1e6);
+}
+
+// sorts the same random 64 bit integers with the serial and the parallel sorts on a growing
+// number of threads, to show how they scale
+
+template<typename SORT>
+uint64_t parallel_loop(const std::vector<long long>& unsorted, int loops, SORT sort)
+{
+	std::vector<long long> array;
+	uint64_t best = 0;
+
+	for (int loop = 0 ; loop < loops ; loop++)
+	{
+		array = unsorted;
+
+		uint64_t start = utime();
+
+		sort(array.begin(), array.end());
+
+		uint64_t time = utime() - start;
+
+		if (loop == 0 || time < best)
+		{
+			best = time;
+		}
+		if (!std::is_sorted(array.begin(), array.end()))
+		{
+			printf("parallel benchmark: unsorted output\n");
+		}
+	}
+	return best;
+}
+
+void parallel_test(int max, int loops, int threads)
+{
+	std::vector<long long> unsorted(max);
+	unsigned long long seed = 1;
+
+	for (int cnt = 0 ; cnt < max ; cnt++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		unsorted[cnt] = (long long) (seed >> 1);
+	}
+
+	printf("Parallel benchmark: array size: %d, loops: %d\n\n", max, loops);
+
+	printf("%s\n", "|                Name |    Items | Threads |   Best ms | Speedup |");
+	printf("%s\n", "| ------------------- | -------- | ------- | --------- | ------- |");
+
+	uint64_t serial = parallel_loop(unsorted, loops, [](auto begin, auto end) { scandum::crumsort(begin, end); });
+
+	printf("|%20s | %8d | %7d | %9.3f | %7.2f |\n", "cxcrumsort", max, 1, serial / 1e6, 1.0);
+
+	for (int count = 1 ; count <= threads ; count = count * 2 <= threads || count == threads ? count * 2 : threads)
+	{
+		uint64_t time = parallel_loop(unsorted, loops, [count](auto begin, auto end) { scandum::parallel_crumsort(begin, end, std::less<long long>(), count); });
+
+		printf("|%20s | %8d | %7d | %9.3f | %7.2f |\n", "parallel_crumsort", max, count, time / 1e6, (double) serial / time);
+	}
+
+	for (int count = 1 ; count <= threads ; count = count * 2 <= threads || count == threads ? count * 2 : threads)
+	{
+		uint64_t time = parallel_loop(unsorted, loops, [count](auto begin, auto end) { scandum::parallel_samplesort(begin, end, std::less<long long>(), count); });
+
+		printf("|%20s | %8d | %7d | %9.3f | %7.2f |\n", "parallel_samplesort", max, count, time / 1e6, (double) serial / time);
+	}
+
+	serial = parallel_loop(unsorted, loops, [](auto begin, auto end) { scandum::quadsort(begin, end); });
+
+	printf("|%20s | %8d | %7d | %9.3f | %7.2f |\n", "cxquadsort", max, 1, serial / 1e6, 1.0);
+
+	for (int count = 1 ; count <= threads ; count = count * 2 <= threads || count == threads ? count * 2 : threads)
+	{
+		uint64_t time = parallel_loop(unsorted, loops, [count](auto begin, auto end) { scandum::parallel_quadsort(begin, end, std::less<long long>(), count); });
+
+		printf("|%20s | %8d | %7d | %9.3f | %7.2f |\n", "parallel_quadsort", max, count, time / 1e6, (double) serial / time);
+	}
+}
+
+// sorts the same random 64 bit integers with the parallel sorts on a growing number of
+// threads, with NUMA placement switched off and on, to show what it gains
+
+void numa_test(int max, int loops, int threads)
+{
+	std::vector<long long> unsorted(max);
+	unsigned long long seed = 1;
+
+	for (int cnt = 0 ; cnt < max ; cnt++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		unsorted[cnt] = (long long) (seed >> 1);
+	}
+
+	bool available = scandum::set_numa_placement(true);
+
+	printf("NUMA benchmark: array size: %d, loops: %d\n\n", max, loops);
+
+	if (!available)
+	{
+		printf("NUMA placement is unavailable: built without SCANDUM_NUMA, or on a single node. Both placements run without it.\n\n");
+	}
+
+	printf("%s\n", "|                Name |    Items | Threads | Placement |   Best ms | Speedup |");
+	printf("%s\n", "| ------------------- | -------- | ------- | --------- | --------- | ------- |");
+
+	for (int sort = 0 ; sort < 3 ; sort++)
+	{
+		const char* name = sort == 0 ? "parallel_crumsort" : sort == 1 ? "parallel_samplesort" : "parallel_quadsort";
+		uint64_t serial = 0;
+
+		for (int count = 1 ; count <= threads ; count = count * 2 <= threads || count == threads ? count * 2 : threads)
+		{
+			for (int numa = 0 ; numa < 2 ; numa++)
+			{
+				scandum::set_numa_placement(numa);
+
+				uint64_t time = parallel_loop(unsorted, loops, [sort, count](auto begin, auto end)
+				{
+					if (sort == 0) scandum::parallel_crumsort(begin, end, std::less<long long>(), count);
+					if (sort == 1) scandum::parallel_samplesort(begin, end, std::less<long long>(), count);
+					if (sort == 2) scandum::parallel_quadsort(begin, end, std::less<long long>(), count);
+				});
+
+				if (serial == 0)
+				{
+					serial = time;
+				}
+				printf("|%20s | %8d | %7d | %9s | %9.3f | %7.2f |\n", name, max, count, numa ? "numa" : "none", time / 1e6, (double) serial / time);
+			}
+		}
+	}
+	scandum::set_numa_placement(true);
+}
+
+// sorts the same random 32 and 64 bit integers and doubles with crumsort and quadsort, with
+// their vector kernels capped at each instruction set the processor supports, or at the one
+// given, to compare them on one machine
+
+template<typename T>
+uint64_t simd_loop(int max, int loops, bool quad)
+{
+	std::vector<T> unsorted(max), array;
+	unsigned long long seed = 1;
+	uint64_t best = 0;
+
+	for (int cnt = 0 ; cnt < max ; cnt++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		unsorted[cnt] = (T) (long long) (seed >> 1);
+	}
+
+	for (int loop = 0 ; loop < loops ; loop++)
+	{
+		array = unsorted;
+
+		uint64_t start = utime();
+
+		if (quad)
+		{
+			scandum::quadsort(array.begin(), array.end(), std::less<T>());
+		}
+		else
+		{
+			scandum::crumsort(array.begin(), array.end(), std::less<T>());
+		}
+
+		uint64_t time = utime() - start;
+
+		if (loop == 0 || time < best)
+		{
+			best = time;
+		}
+		if (!std::is_sorted(array.begin(), array.end()))
+		{
+			printf("simd benchmark: unsorted output\n");
+		}
+	}
+	return best;
+}
+
+void simd_test(int max, int loops, const char *only)
+{
+	const char *names[] = { "scalar", "avx2", "avx512" };
+	scandum::simd_isa widest = scandum::set_simd_isa(scandum::simd_isa::avx512);
+
+	printf("SIMD benchmark: array size: %d, loops: %d, widest instruction set: %s\n\n", max, loops, names[(int) widest]);
+
+	printf("%s\n", "|      Name |      Type |    Items |    ISA |   Best ms | Speedup |");
+	printf("%s\n", "| --------- | --------- | -------- | ------ | --------- | ------- |");
+
+	for (int sort = 0 ; sort < 2 ; sort++)
+	{
+		for (int type = 0 ; type < 3 ; type++)
+		{
+			uint64_t scalar = 0;
+
+			for (int isa = 0 ; isa <= (int) widest ; isa++)
+			{
+				if (isa && only && strcmp(only, names[isa]))
+				{
+					continue;
+				}
+				scandum::set_simd_isa((scandum::simd_isa) isa);
+
+				uint64_t time = type == 0 ? simd_loop<int>(max, loops, sort) : type == 1 ? simd_loop<long long>(max, loops, sort) : simd_loop<double>(max, loops, sort);
+
+				if (isa == 0)
+				{
+					scalar = time;
+				}
+				printf("|%10s | %9s | %8d | %6s | %9.3f | %7.2f |\n", sort ? "cxquadsort" : "cxcrumsort", type == 0 ? "int" : type == 1 ? "long long" : "double", max, names[isa], time / 1e6, (double) scalar / time);
+			}
+		}
+	}
+	scandum::set_simd_isa(scandum::simd_isa::avx512);
+}
+
 #define VAR int
 
 int main(int argc, char **argv)
@@ -772,6 +1114,70 @@ int main(int argc, char **argv)
 	}
 #endif
 
+	// bench arena [size] [loops] [threads]
+
+	if (argc >= 2 && !strcmp(argv[1], "arena"))
+	{
+		int threads = (int) std::thread::hardware_concurrency();
+
+		max = argc >= 3 ? atoi(argv[2]) : 1000;
+		samples = argc >= 4 ? atoi(argv[3]) : 10000;
+		threads = argc >= 5 ? atoi(argv[4]) : (threads ? threads : 1);
+
+		arena_test(max, samples, threads);
+		return 0;
+	}
+
+	// bench parallel [size] [loops] [threads]
+
+	if (argc >= 2 && !strcmp(argv[1], "parallel"))
+	{
+		int threads = (int) std::thread::hardware_concurrency();
+
+		max = argc >= 3 ? atoi(argv[2]) : 10000000;
+		samples = argc >= 4 ? atoi(argv[3]) : 5;
+		threads = argc >= 5 ? atoi(argv[4]) : (threads ? threads : 1);
+
+		parallel_test(max, samples, threads);
+		return 0;
+	}
+
+	// bench numa [size] [loops] [threads]
+
+	if (argc >= 2 && !strcmp(argv[1], "numa"))
+	{
+		int threads = (int) std::thread::hardware_concurrency();
+
+		max = argc >= 3 ? atoi(argv[2]) : 100000000;
+		samples = argc >= 4 ? atoi(argv[3]) : 5;
+		threads = argc >= 5 ? atoi(argv[4]) : (threads ? threads : 1);
+
+		numa_test(max, samples, threads);
+		return 0;
+	}
+
+	// bench simd [size] [loops] [scalar|avx2|avx512]
+
+	if (argc >= 2 && !strcmp(argv[1], "simd"))
+	{
+		max = argc >= 3 ? atoi(argv[2]) : 1000000;
+		samples = argc >= 4 ? atoi(argv[3]) : 10;
+
+		simd_test(max, samples, argc >= 5 ? argv[4] : NULL);
+		return 0;
+	}
+
+	// bench hugepages [size] [loops]
+
+	if (argc >= 2 && !strcmp(argv[1], "hugepages"))
+	{
+		max = argc >= 3 ? atoi(argv[2]) : 10000000;
+		samples = argc >= 4 ? atoi(argv[3]) : 10;
+
+		hugepage_test(max, samples);
+		return 0;
+	}
+
 	if (argc >= 1 && argv[1] && *argv[1])
 	{
 		max = atoi(argv[1]);
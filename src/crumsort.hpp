@@ -5,8 +5,8 @@
 
 // When sorting an array of pointers, like a string array, the QUAD_CACHE needs
 // to be set for proper performance when sorting large arrays.
-// crumsort_prim() can be used to sort arrays of 32 and 64 bit integers
-// without a comparison function or cache restrictions.
+// crumsort_prim() can be used to sort arrays of integers and floating point
+// numbers without a comparison function or cache restrictions.
 
 // With a 6 MB L3 cache a value of 262144 works well.
 
@@ -23,24 +23,159 @@
 
 #define CRUM_OUT   96
 
+// The parallel sorts hand partitions of more than this many elements to the
+// next idle thread
+
+#ifndef CRUM_TASK
+#define CRUM_TASK 32768
+#endif
+
+// and partition arrays of more than this many elements, too many to fit in
+// cache, on all threads together
+
+#ifndef CRUM_BLOCK
+#define CRUM_BLOCK 262144
+#endif
+
+// The sample sort splits arrays into at most this many buckets, picking the
+// splitters from a sample of this many elements per bucket
+
+#ifndef CRUM_BUCKETS
+#define CRUM_BUCKETS 256
+#endif
+
+#ifndef CRUM_OVERSAMPLE
+#define CRUM_OVERSAMPLE 64
+#endif
+
 // comparison functions
 
 #define scandum_greater(less, lhs, rhs) less(rhs, lhs)
-#define scandum_not_greater(less, lhs, rhs) (less(lhs, rhs) || !less(rhs, lhs))
+#define scandum_not_greater(less, lhs, rhs) ::scandum::detail::not_greater(less, lhs, rhs)
 
 #define scandum_move(x) std::move(x)
 #define scandum_conditional_assign(pred, dest_a, dest_b, value) \
-	if (pred) dest_a = scandum_move(value); else dest_b = scandum_move(value)
+	if (pred) detail::move_assign(dest_a, value); else detail::move_assign(dest_b, value)
 
 namespace scandum {
 
 namespace detail {
 
-template<typename T, typename Iterator, typename Compare>
-void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb, Compare cmp);
+// The partitions can write an element back to the slot it was just read from. That is harmless
+// for trivially copyable types, but a self move assignment may leave other types empty.
+
+template<typename T>
+inline void move_assign(T& dest, T& src)
+{
+	if constexpr (std::is_trivially_copyable_v<T>)
+	{
+		dest = scandum_move(src);
+	}
+	else if (&dest != &src)
+	{
+		dest = scandum_move(src);
+	}
+}
+
+// The partitions on either side of a pivot can be sorted independently. A
+// fork is offered the right one and may sort it elsewhere, in which case it
+// returns true; wait() returns once everything it took on is sorted. It may
+// also take on partitioning an array around a pivot, returning true and the
+// size of the left side when it does. The serial sorts use this one, which
+// never takes anything on.
+
+struct crum_serial {
+	static constexpr bool parallel = false;
+
+	template<typename Iterator, typename T, typename Compare>
+	bool operator()(Iterator, T*, size_t, Compare) const
+	{
+		return false;
+	}
+
+	template<typename Iterator, typename T, typename Compare>
+	bool partition(Iterator, T*, size_t, Compare, size_t&) const
+	{
+		return false;
+	}
+
+	void wait() const {}
+};
+
+template<typename T, typename Iterator, typename Compare, typename Fork = crum_serial>
+void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb, Compare cmp, Fork fork = Fork());
+
+#ifdef SCANDUM_SIMD
+
+// the number of the 32 keys at array that are greater than the key after them,
+// comparing each vector of keys with the one a key further on
+
+template<typename T, typename Compare>
+SCANDUM_TARGET_AVX2 inline unsigned char avx2_descents(const T* array)
+{
+	constexpr size_t lanes = 32 / sizeof(T);
+	unsigned int sum = 0;
+
+	for (size_t i = 0 ; i < 32 ; i += lanes)
+	{
+		__m256i vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(array + i));
+		__m256i nxt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(array + i + 1));
+
+		sum += _mm_popcnt_u32(avx2_compare<T, Compare>(nxt, vec));
+	}
+	return static_cast<unsigned char>(sum);
+}
+
+template<typename T, typename Compare>
+SCANDUM_TARGET_AVX512 inline unsigned char avx512_descents(const T* array)
+{
+	constexpr size_t lanes = 64 / sizeof(T);
+	unsigned int sum = 0;
+
+	for (size_t i = 0 ; i < 32 ; i += lanes)
+	{
+		__m512i vec = _mm512_loadu_si512(array + i);
+		__m512i nxt = _mm512_loadu_si512(array + i + 1);
+
+		sum += _mm_popcnt_u32(avx512_compare<T, Compare>(nxt, vec));
+	}
+	return static_cast<unsigned char>(sum);
+}
+
+// crum_analyze() counts the descents of the next 32 keys of each quarter with
+// vector compares the processor supports, returning false if none. The counts
+// are those of the scalar loop, so are the decisions taken on them.
 
 template<typename T, typename Iterator, typename Compare>
-void crum_analyze(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
+bool crum_simd_descents(Iterator pta, Iterator ptb, Iterator ptc, Iterator ptd, unsigned char* sums)
+{
+	if constexpr (is_simd_key_v<T, Iterator, Compare>)
+	{
+		switch (cpu_simd_isa())
+		{
+			case simd_isa::avx512:
+				sums[0] = avx512_descents<T, Compare>(pta);
+				sums[1] = avx512_descents<T, Compare>(ptb);
+				sums[2] = avx512_descents<T, Compare>(ptc);
+				sums[3] = avx512_descents<T, Compare>(ptd);
+				return true;
+			case simd_isa::avx2:
+				sums[0] = avx2_descents<T, Compare>(pta);
+				sums[1] = avx2_descents<T, Compare>(ptb);
+				sums[2] = avx2_descents<T, Compare>(ptc);
+				sums[3] = avx2_descents<T, Compare>(ptd);
+				return true;
+			default:
+				break;
+		}
+	}
+	return false;
+}
+
+#endif
+
+template<typename T, typename Iterator, typename Compare, typename Fork = crum_serial>
+void crum_analyze(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp, Fork fork = Fork())
 {
 	unsigned char loop, asum, bsum, csum, dsum;
 	unsigned int astreaks, bstreaks, cstreaks, dstreaks;
@@ -65,6 +200,18 @@ void crum_analyze(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp
 
 	for (cnt = nmemb ; cnt > 132 ; cnt -= 128)
 	{
+#ifdef SCANDUM_SIMD
+		unsigned char sums[4];
+
+		if (crum_simd_descents<T, Iterator, Compare>(pta, ptb, ptc, ptd, sums))
+		{
+			asum = sums[0]; pta += 32;
+			bsum = sums[1]; ptb += 32;
+			csum = sums[2]; ptc += 32;
+			dsum = sums[3]; ptd += 32;
+		}
+		else
+#endif
 		for (asum = bsum = csum = dsum = 0, loop = 32 ; loop ; loop--)
 		{
 			asum += scandum_greater(cmp, *pta, *(pta + 1)); pta++;
@@ -142,7 +289,7 @@ void crum_analyze(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp
 #ifdef cmp
 	cnt = nmemb / 256; // switch to quadsort if at least 50% ordered
 #else
-	cnt = nmemb / 512; // switch to quadsort if at least 25% ordered
+	cnt = is_prim_compare_v<Compare> ? nmemb / 256 : nmemb / 512; // 50% or 25% ordered
 #endif
 	asum = astreaks > cnt;
 	bsum = bstreaks > cnt;
@@ -150,7 +297,10 @@ void crum_analyze(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp
 	dsum = dstreaks > cnt;
 
 #ifndef cmp
-	if (quad1 > QUAD_CACHE)
+	// sorting the quarters apart keeps them in cache, but the merges that
+	// follow would run on one thread, so parallel sorts partition it whole
+
+	if (quad1 > QUAD_CACHE && !Fork::parallel && !is_prim_compare_v<Compare>)
 	{
 //		asum = bsum = csum = dsum = 1;
 		goto quad_cache;
@@ -160,38 +310,38 @@ void crum_analyze(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp
 	switch (asum + bsum * 2 + csum * 4 + dsum * 8)
 	{
 		case 0:
-			fulcrum_partition<T>(array, swap, (T*)nullptr, nmemb, cmp);
+			fulcrum_partition<T>(array, swap, (T*)nullptr, nmemb, cmp, fork);
 			return;
 		case 1:
 			if (abalance) quadsort_swap<T>(array, swap, quad1, cmp);
-			fulcrum_partition<T>(pta + 1, swap, (T*)nullptr, quad2 + half2, cmp);
+			fulcrum_partition<T>(pta + 1, swap, (T*)nullptr, quad2 + half2, cmp, fork);
 			break;
 		case 2:
-			fulcrum_partition<T>(array, swap, (T*)nullptr, quad1, cmp);
+			fulcrum_partition<T>(array, swap, (T*)nullptr, quad1, cmp, fork);
 			if (bbalance) quadsort_swap<T>(pta + 1, swap, quad2, cmp);
-			fulcrum_partition<T>(ptb + 1, swap, (T*)nullptr, half2, cmp);
+			fulcrum_partition<T>(ptb + 1, swap, (T*)nullptr, half2, cmp, fork);
 			break;
 		case 3:
 			if (abalance) quadsort_swap<T>(array, swap, quad1, cmp);
 			if (bbalance) quadsort_swap<T>(pta + 1, swap, quad2, cmp);
-			fulcrum_partition<T>(ptb + 1, swap, (T*)nullptr, half2, cmp);
+			fulcrum_partition<T>(ptb + 1, swap, (T*)nullptr, half2, cmp, fork);
 			break;
 		case 4:
-			fulcrum_partition<T>(array, swap, (T*)nullptr, half1, cmp);
+			fulcrum_partition<T>(array, swap, (T*)nullptr, half1, cmp, fork);
 			if (cbalance) quadsort_swap<T>(ptb + 1, swap, quad3, cmp);
-			fulcrum_partition<T>(ptc + 1, swap, (T*)nullptr, quad4, cmp);
+			fulcrum_partition<T>(ptc + 1, swap, (T*)nullptr, quad4, cmp, fork);
 			break;
 		case 8:
-			fulcrum_partition<T>(array, swap, (T*)nullptr, half1 + quad3, cmp);
+			fulcrum_partition<T>(array, swap, (T*)nullptr, half1 + quad3, cmp, fork);
 			if (dbalance) quadsort_swap<T>(ptc + 1, swap, quad4, cmp);
 			break;
 		case 9:
 			if (abalance) quadsort_swap<T>(array, swap, quad1, cmp);
-			fulcrum_partition<T>(pta + 1, swap, (T*)nullptr, quad2 + quad3, cmp);
+			fulcrum_partition<T>(pta + 1, swap, (T*)nullptr, quad2 + quad3, cmp, fork);
 			if (dbalance) quadsort_swap<T>(ptc + 1, swap, quad4, cmp);
 			break;
 		case 12:
-			fulcrum_partition<T>(array, swap, (T*)nullptr, half1, cmp);
+			fulcrum_partition<T>(array, swap, (T*)nullptr, half1, cmp, fork);
 			if (cbalance) quadsort_swap<T>(ptb + 1, swap, quad3, cmp);
 			if (dbalance) quadsort_swap<T>(ptc + 1, swap, quad4, cmp);
 			break;
@@ -210,24 +360,25 @@ void crum_analyze(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp
 			{
 				if (abalance) quadsort_swap<T>(array, swap, quad1, cmp);
 			}
-			else fulcrum_partition<T>(array, swap, (T*)nullptr, quad1, cmp);
+			else fulcrum_partition<T>(array, swap, (T*)nullptr, quad1, cmp, fork);
 			if (bsum)
 			{
 				if (bbalance) quadsort_swap<T>(pta + 1, swap, quad2, cmp);
 			}
-			else fulcrum_partition<T>(pta + 1, swap, (T*)nullptr, quad2, cmp);
+			else fulcrum_partition<T>(pta + 1, swap, (T*)nullptr, quad2, cmp, fork);
 			if (csum)
 			{
 				if (cbalance) quadsort_swap<T>(ptb + 1, swap, quad3, cmp);
 			}
-			else fulcrum_partition<T>(ptb + 1, swap, (T*)nullptr, quad3, cmp);
+			else fulcrum_partition<T>(ptb + 1, swap, (T*)nullptr, quad3, cmp, fork);
 			if (dsum)
 			{
 				if (dbalance) quadsort_swap<T>(ptc + 1, swap, quad4, cmp);
 			}
-			else fulcrum_partition<T>(ptc + 1, swap, (T*)nullptr, quad4, cmp);
+			else fulcrum_partition<T>(ptc + 1, swap, (T*)nullptr, quad4, cmp, fork);
 			break;
 	}
+	fork.wait();
 
 	if (scandum_not_greater(cmp, *pta, *(pta + 1)))
 	{
@@ -270,19 +421,21 @@ Iterator crum_binary_median(Iterator pta, Iterator ptb, size_t len, Compare cmp)
 template<typename T, typename Iterator, typename Compare>
 Iterator crum_median_of_cbrt(Iterator array, swap_space<T>& swap, size_t nmemb, int* generic, Compare cmp)
 {
-	Iterator pta, piv;
-	size_t cnt, cbrt, div;
+	Iterator piv;
+	size_t cnt, cbrt, div, pta;
 
 	for (cbrt = 32 ; nmemb > cbrt * cbrt * cbrt && cbrt < swap.size() ; cbrt *= 2) {}
 
 	div = nmemb / cbrt;
 
-	pta = array + nmemb - 1 - (size_t)&div / 64 % div;
+	// track the sample as an index, stepping an iterator past the last sample could move it before array
+
+	pta = nmemb - 1 - (size_t)&div / 64 % div;
 	piv = array + cbrt;
 
 	for (cnt = cbrt ; cnt ; cnt--)
 	{
-		*swap.begin() = scandum_move(*--piv); *piv = scandum_move(*pta); *pta = scandum_move(*swap.begin());
+		*swap.begin() = scandum_move(*--piv); *piv = scandum_move(array[pta]); array[pta] = scandum_move(*swap.begin());
 
 		pta -= div;
 	}
@@ -322,12 +475,271 @@ Iterator crum_median_of_nine(Iterator array, size_t nmemb, Compare cmp)
 	return array + crum_median_of_three(array, x, y, z, cmp);
 }
 
+#ifdef SCANDUM_SIMD
+
+// fulcrum_default_partition() and fulcrum_reverse_partition() for primitive
+// keys, which classify a vector of keys at a time. Whichever end of the array
+// a block of 16 keys is read from has room for all of them on the other end,
+// as in the scalar partitions, so the AVX2 kernel permutes the keys going
+// left to the front of the vector and the rest to the back, and stores the
+// whole vector at both ends of the gap. AVX-512 compresses each side into a
+// vector of its own, stores the left one whole and then just the lanes of the
+// right one, which overwrite any the left one spilled into them.
+
+// the lanes of each mask followed by the other lanes, as bytes holding the
+// index of a 32 bit lane
+
+template<size_t Lanes>
+struct avx2_compress_table {
+	unsigned long long index[1 << Lanes];
+
+	constexpr avx2_compress_table() : index()
+	{
+		for (size_t mask = 0 ; mask < (1 << Lanes) ; mask++)
+		{
+			size_t out = 0;
+
+			for (size_t pass = 0 ; pass < 2 ; pass++)
+			{
+				for (size_t lane = 0 ; lane < Lanes ; lane++)
+				{
+					if ((mask >> lane & 1) == (pass == 0))
+					{
+						for (size_t half = 0 ; half < 8 / Lanes ; half++, out++)
+						{
+							index[mask] |= static_cast<unsigned long long>(lane * 8 / Lanes + half) << (out * 8);
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+template<size_t Lanes>
+inline constexpr avx2_compress_table<Lanes> avx2_compress;
+
+// partitions the keys at pta, storing those going left at ptl and the others
+// ending at ptr, and returns how many went left
+
+template<typename T, bool Reverse, typename Compare>
+SCANDUM_TARGET_AVX2 inline size_t avx2_partition(const T* pta, T* ptl, T* ptr, __m256i piv)
+{
+	constexpr size_t lanes = 32 / sizeof(T);
+
+	__m256i vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pta));
+	unsigned mask = Reverse ? avx2_compare<T, Compare>(vec, piv) : avx2_compare<T, Compare>(piv, vec) ^ ((1u << lanes) - 1);
+	__m256i index = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(avx2_compress<lanes>.index[mask])));
+
+	vec = _mm256_permutevar8x32_epi32(vec, index);
+
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(ptl), vec);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr + 1 - lanes), vec);
+
+	return _mm_popcnt_u32(mask);
+}
+
+template<typename T, bool Reverse, typename Compare>
+SCANDUM_TARGET_AVX2 size_t fulcrum_avx2_partition(T* array, T* swap, T* piv, size_t nmemb, Compare cmp)
+{
+	constexpr size_t lanes = 32 / sizeof(T);
+
+	size_t i, cnt, val, m = 0;
+	T *ptl, *ptr, *pta, *tpa;
+	__m256i pivot = avx2_set1<T>(*piv);
+
+	std::copy(array, array + 32, swap);
+	std::copy(array + nmemb - 32, array + nmemb, swap + 32);
+
+	ptl = array;
+	ptr = array + nmemb - 1;
+
+	pta = array + 32;
+	tpa = array + nmemb - 33;
+
+	cnt = nmemb / 16 - 4;
+
+	while (1)
+	{
+		if (pta - ptl - m <= 48)
+		{
+			if (cnt-- == 0) break;
+
+			for (i = 16 / lanes ; i ; i--)
+			{
+				m += avx2_partition<T, Reverse, Compare>(pta, ptl + m, ptr + m, pivot); pta += lanes; ptr -= lanes;
+			}
+		}
+		if (pta - ptl - m >= 16)
+		{
+			if (cnt-- == 0) break;
+
+			for (i = 16 / lanes ; i ; i--)
+			{
+				tpa -= lanes; m += avx2_partition<T, Reverse, Compare>(tpa + 1, ptl + m, ptr + m, pivot); ptr -= lanes;
+			}
+		}
+	}
+
+	if (pta - ptl - m <= 48)
+	{
+		for (cnt = nmemb % 16 ; cnt ; cnt--)
+		{
+			val = Reverse ? cmp(*pta, *piv) : !cmp(*piv, *pta); ptl[m] = ptr[m] = *pta++; m += val; ptr--;
+		}
+	}
+	else
+	{
+		for (cnt = nmemb % 16 ; cnt ; cnt--)
+		{
+			val = Reverse ? cmp(*tpa, *piv) : !cmp(*piv, *tpa); ptl[m] = ptr[m] = *tpa--; m += val; ptr--;
+		}
+	}
+
+	// the gap now holds exactly the 64 keys in the swap, too few to take the
+	// lanes of both ends of the last vectors
+
+	pta = swap;
+
+	for (cnt = 64 ; cnt >= lanes * 2 ; cnt -= lanes)
+	{
+		m += avx2_partition<T, Reverse, Compare>(pta, ptl + m, ptr + m, pivot); pta += lanes; ptr -= lanes;
+	}
+	for ( ; cnt ; cnt--)
+	{
+		val = Reverse ? cmp(*pta, *piv) : !cmp(*piv, *pta); ptl[m] = ptr[m] = *pta++; m += val; ptr--;
+	}
+	return m;
+}
+
+template<typename T, bool Reverse, typename Compare>
+SCANDUM_TARGET_AVX512 inline size_t avx512_partition(const T* pta, T* ptl, T* ptr, __m512i piv)
+{
+	constexpr size_t lanes = 64 / sizeof(T);
+
+	__m512i vec = _mm512_loadu_si512(pta);
+	unsigned mask = Reverse ? avx512_compare<T, Compare>(vec, piv) : avx512_compare<T, Compare>(piv, vec) ^ ((1u << lanes) - 1);
+	unsigned left = _mm_popcnt_u32(mask), right = lanes - left;
+
+	if constexpr (sizeof(T) == 4)
+	{
+		_mm512_storeu_si512(ptl, _mm512_maskz_compress_epi32(static_cast<__mmask16>(mask), vec));
+		_mm512_mask_storeu_epi32(ptr + 1 - right, static_cast<__mmask16>((1u << right) - 1), _mm512_maskz_compress_epi32(static_cast<__mmask16>(~mask), vec));
+	}
+	else
+	{
+		_mm512_storeu_si512(ptl, _mm512_maskz_compress_epi64(static_cast<__mmask8>(mask), vec));
+		_mm512_mask_storeu_epi64(ptr + 1 - right, static_cast<__mmask8>((1u << right) - 1), _mm512_maskz_compress_epi64(static_cast<__mmask8>(~mask), vec));
+	}
+	return left;
+}
+
+template<typename T, bool Reverse, typename Compare>
+SCANDUM_TARGET_AVX512 size_t fulcrum_avx512_partition(T* array, T* swap, T* piv, size_t nmemb, Compare cmp)
+{
+	constexpr size_t lanes = 64 / sizeof(T);
+
+	size_t i, cnt, val, m = 0;
+	T *ptl, *ptr, *pta, *tpa;
+	__m512i pivot = avx512_set1<T>(*piv);
+
+	std::copy(array, array + 32, swap);
+	std::copy(array + nmemb - 32, array + nmemb, swap + 32);
+
+	ptl = array;
+	ptr = array + nmemb - 1;
+
+	pta = array + 32;
+	tpa = array + nmemb - 33;
+
+	cnt = nmemb / 16 - 4;
+
+	while (1)
+	{
+		if (pta - ptl - m <= 48)
+		{
+			if (cnt-- == 0) break;
+
+			for (i = 16 / lanes ; i ; i--)
+			{
+				m += avx512_partition<T, Reverse, Compare>(pta, ptl + m, ptr + m, pivot); pta += lanes; ptr -= lanes;
+			}
+		}
+		if (pta - ptl - m >= 16)
+		{
+			if (cnt-- == 0) break;
+
+			for (i = 16 / lanes ; i ; i--)
+			{
+				tpa -= lanes; m += avx512_partition<T, Reverse, Compare>(tpa + 1, ptl + m, ptr + m, pivot); ptr -= lanes;
+			}
+		}
+	}
+
+	if (pta - ptl - m <= 48)
+	{
+		for (cnt = nmemb % 16 ; cnt ; cnt--)
+		{
+			val = Reverse ? cmp(*pta, *piv) : !cmp(*piv, *pta); ptl[m] = ptr[m] = *pta++; m += val; ptr--;
+		}
+	}
+	else
+	{
+		for (cnt = nmemb % 16 ; cnt ; cnt--)
+		{
+			val = Reverse ? cmp(*tpa, *piv) : !cmp(*piv, *tpa); ptl[m] = ptr[m] = *tpa--; m += val; ptr--;
+		}
+	}
+
+	// only the left lanes spill, so the keys in the swap fill the gap to the
+	// last
+
+	pta = swap;
+
+	for (cnt = 64 / lanes ; cnt ; cnt--)
+	{
+		m += avx512_partition<T, Reverse, Compare>(pta, ptl + m, ptr + m, pivot); pta += lanes; ptr -= lanes;
+	}
+	return m;
+}
+
+// the vector partition the processor supports, returning false if none
+
+template<bool Reverse, typename T, typename Iterator, typename Compare>
+bool fulcrum_simd_partition(Iterator array, swap_space<T>& swap, T* piv, size_t nmemb, Compare cmp, size_t& m)
+{
+	if constexpr (is_simd_key_v<T, Iterator, Compare>)
+	{
+		switch (cpu_simd_isa())
+		{
+			case simd_isa::avx512:
+				m = fulcrum_avx512_partition<T, Reverse>(array, swap.begin(), piv, nmemb, cmp);
+				return true;
+			case simd_isa::avx2:
+				m = fulcrum_avx2_partition<T, Reverse>(array, swap.begin(), piv, nmemb, cmp);
+				return true;
+			default:
+				break;
+		}
+	}
+	return false;
+}
+
+#endif
+
 template<typename T, typename Iterator, typename Compare>
 size_t fulcrum_default_partition(Iterator array, swap_space<T>& swap, Iterator ptx, T* piv, size_t nmemb, Compare cmp)
 {
 	size_t i, cnt, val, m = 0;
 	Iterator ptl, ptr, pta, tpa;
 
+#ifdef SCANDUM_SIMD
+	if (fulcrum_simd_partition<false>(array, swap, piv, nmemb, cmp, m))
+	{
+		return m;
+	}
+#endif
+
 	scandum_copy_range(T, swap.begin(), array, 32);
 	scandum_copy_range(T, swap.begin() + 32, array + nmemb - 32, 32);
 
@@ -403,6 +815,13 @@ size_t fulcrum_reverse_partition(Iterator array, swap_space<T>& swap, Iterator p
 	size_t i, cnt, val, m = 0;
 	Iterator ptl, ptr, pta, tpa;
 
+#ifdef SCANDUM_SIMD
+	if (fulcrum_simd_partition<true>(array, swap, piv, nmemb, cmp, m))
+	{
+		return m;
+	}
+#endif
+
 	scandum_copy_range(T, swap.begin(), array, 32);
 	scandum_copy_range(T, swap.begin() + 32, array + nmemb - 32, 32);
 
@@ -470,14 +889,23 @@ size_t fulcrum_reverse_partition(Iterator array, swap_space<T>& swap, Iterator p
 	return m;
 }
 
-template<typename T, typename Iterator, typename Compare>
-void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb, Compare cmp)
+template<typename T, typename Iterator, typename Compare, typename Fork>
+void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb, Compare cmp, Fork fork)
 {
 	size_t a_size, s_size;
 	Iterator ptp;
-	temp_var<T> piv;
+	temp_var<T> var(array);
+	T& piv = var;
 	int generic = 0;
 
+	// crum_analyze() can hand over quarters that are too small to partition
+
+	if (nmemb <= CRUM_OUT)
+	{
+		quadsort_swap<T>(array, swap, nmemb, cmp);
+		return;
+	}
+
 	while (1)
 	{
 		if (nmemb <= 2048)
@@ -491,11 +919,16 @@ void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb
 			if (generic) break;
 		}
 		piv = scandum_move(*ptp);
+		*ptp = scandum_move(array[--nmemb]);
 
 		if (max && scandum_not_greater(cmp, *max, piv))
 		{
-			a_size = fulcrum_reverse_partition<T>(array, swap, array, &(T&)piv, nmemb, cmp);
-			s_size = nmemb - a_size;
+			// the pivot compares equal to max, so parking it at the end places it on the right side of the partition
+
+			array[nmemb] = scandum_move(piv);
+
+			a_size = fulcrum_reverse_partition<T>(array, swap, array, &*(array + nmemb), nmemb, cmp);
+			s_size = nmemb + 1 - a_size;
 			nmemb = a_size;
 
 			if (s_size <= a_size / 32 || a_size <= CRUM_OUT) break;
@@ -503,9 +936,10 @@ void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb
 			max = nullptr;
 			continue;
 		}
-		*ptp = scandum_move(array[--nmemb]);
-
-		a_size = fulcrum_default_partition<T>(array, swap, array, &(T&)piv, nmemb, cmp);
+		if (!fork.partition(array, &piv, nmemb, cmp, a_size))
+		{
+			a_size = fulcrum_default_partition<T>(array, swap, array, &piv, nmemb, cmp);
+		}
 		s_size = nmemb - a_size;
 
 		ptp = array + a_size; array[nmemb] = scandum_move(*ptp); *ptp = scandum_move(piv);
@@ -514,9 +948,9 @@ void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb
 		{
 			quadsort_swap<T>(ptp + 1, swap, s_size, cmp);
 		}
-		else
+		else if (!fork(ptp + 1, max, s_size, cmp))
 		{
-			fulcrum_partition<T>(ptp + 1, swap, max, s_size, cmp);
+			fulcrum_partition<T>(ptp + 1, swap, max, s_size, cmp, fork);
 		}
 		nmemb = a_size;
 
@@ -524,7 +958,7 @@ void fulcrum_partition(Iterator array, swap_space<T>& swap, T* max, size_t nmemb
 		{
 			if (a_size <= CRUM_OUT) break;
 
-			a_size = fulcrum_reverse_partition<T>(array, swap, array, &(T&)piv, nmemb, cmp);
+			a_size = fulcrum_reverse_partition<T>(array, swap, array, &*ptp, nmemb, cmp);
 			s_size = nmemb - a_size;
 			nmemb = a_size;
 
@@ -551,41 +985,762 @@ void crumsort_swap(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cm
 	}
 }
 
-} // namespace scandum::detail
+// crumsort() with swap space on the stack for up to 256 elements, and from
+// source, or else the thread's arena or the heap, for anything larger
 
-template<typename Iterator, typename Compare>
-void crumsort(Iterator begin, const Iterator end, Compare cmp, size_t max_swap_size = 512)
+template<typename T, typename Iterator, typename Compare>
+void crumsort_with(Iterator array, size_t nmemb, size_t max_swap_size, Compare cmp, const scratch_allocator* source = nullptr)
 {
-	static_assert (
-#if __cplusplus >= 202002L
-		std::random_access_iterator<Iterator>,
-#else
-		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
-#endif
-		"type 'Iterator' must be a random access iterator"
-	);
-
-	assert(max_swap_size > 0);
+	stack_swap<T, 256> stack;
 
-	typedef std::remove_reference_t<decltype(*begin)> T;
-
-	size_t nmemb = static_cast<size_t>(end - begin);
+	// fulcrum_partition() hands partitions of up to CRUM_OUT elements to quadsort_swap()
 
 	if (nmemb <= 256)
 	{
-		detail::swap_space<T> swap(nmemb);
-		detail::quadsort_swap<T>(begin, swap, nmemb, cmp);
+		swap_space<T> swap(nmemb, std::min<size_t>(nmemb, CRUM_OUT), stack, array, source);
+		quadsort_swap<T>(array, swap, nmemb, cmp);
 		return;
 	}
-	detail::swap_space<T> swap(max_swap_size);
-	detail::crum_analyze<T>(begin, swap, nmemb, cmp);
+	swap_space<T> swap(max_swap_size, CRUM_OUT, stack, array, source);
+	crum_analyze<T>(array, swap, nmemb, cmp);
 }
 
-template<typename Iterator>
-void crumsort(Iterator begin, Iterator end)
+// A stretch of the array, either side of a partition, holding the elements
+// that ended up on the wrong side of the whole array
+
+struct crum_stretch {
+	size_t start, length;
+};
+
+// Partitions the array around piv on the pool, in three steps. Every worker
+// partitions stripes of the array with fulcrum_default_partition(), adding up
+// the left sides of the stripes gives the size of the left side of the array,
+// and the elements on the wrong side of that boundary are swapped across in
+// stretches of equal length. Swap spaces hold nothing while their worker
+// waits, so the tasks can use whichever one belongs to the worker they run on.
+// Stripes and stretches are at least grain elements long, and are queued on
+// the worker owning that part of the array.
+
+template<typename T, typename Iterator, typename Compare>
+bool parallel_fulcrum_partition(task_pool& pool, swap_space<T>** swaps, size_t worker, Iterator array, T* piv, size_t nmemb, Compare cmp, size_t& a_size, size_t grain = CRUM_TASK)
 {
-	typedef std::remove_reference_t<decltype(*begin)> T;
-	return crumsort(begin, end, std::less<T>());
+	size_t stripes = std::min(pool.size(), nmemb / grain);
+
+	if (stripes < 2)
+	{
+		return false;
+	}
+	task_pool::group group;
+	std::vector<size_t> left(stripes);
+	std::vector<crum_stretch> misplaced_left, misplaced_right;
+
+	for (size_t stripe = 0 ; stripe < stripes ; stripe++)
+	{
+		size_t start = nmemb * stripe / stripes;
+		size_t length = nmemb * (stripe + 1) / stripes - start;
+		size_t* result = &left[stripe];
+
+		auto job = [=](size_t worker)
+		{
+			*result = fulcrum_default_partition<T>(array + start, *swaps[worker], array + start, piv, length, cmp);
+		};
+
+		try
+		{
+			pool.push(pool.owner(start, nmemb), group, job);
+		}
+		catch (...)
+		{
+			pool.wait(worker, group);
+			throw;
+		}
+	}
+	pool.wake();
+	pool.wait(worker, group);
+
+	if (pool.failed())
+	{
+		return false;
+	}
+	a_size = 0;
+
+	for (size_t stripe = 0 ; stripe < stripes ; stripe++)
+	{
+		a_size += left[stripe];
+	}
+
+	size_t misplaced = 0;
+
+	for (size_t stripe = 0 ; stripe < stripes ; stripe++)
+	{
+		size_t start = nmemb * stripe / stripes;
+		size_t pivot = start + left[stripe];
+		size_t end = nmemb * (stripe + 1) / stripes;
+
+		if (pivot < a_size && end > pivot)
+		{
+			misplaced_right.push_back({ pivot, std::min(end, a_size) - pivot });
+			misplaced += misplaced_right.back().length;
+		}
+		if (pivot > a_size && pivot > start)
+		{
+			size_t from = std::max(start, a_size);
+
+			misplaced_left.push_back({ from, pivot - from });
+		}
+	}
+
+	size_t length = std::max<size_t>(grain, misplaced / pool.size() + 1);
+
+	for (size_t offset = 0 ; offset < misplaced ; offset += length)
+	{
+		size_t total = std::min(length, misplaced - offset);
+
+		auto job = [&, offset, total](size_t)
+		{
+			size_t lcnt = 0, rcnt = 0, lpos = offset, rpos = offset;
+
+			while (lpos >= misplaced_left[lcnt].length) lpos -= misplaced_left[lcnt++].length;
+			while (rpos >= misplaced_right[rcnt].length) rpos -= misplaced_right[rcnt++].length;
+
+			for (size_t todo = total ; todo ; )
+			{
+				size_t step = std::min({ todo, misplaced_left[lcnt].length - lpos, misplaced_right[rcnt].length - rpos });
+				Iterator pta = array + (misplaced_left[lcnt].start + lpos);
+				Iterator ptb = array + (misplaced_right[rcnt].start + rpos);
+
+				std::swap_ranges(pta, pta + step, ptb);
+
+				todo -= step;
+				lpos += step;
+				rpos += step;
+
+				if (lpos == misplaced_left[lcnt].length) { lcnt++; lpos = 0; }
+				if (rpos == misplaced_right[rcnt].length) { rcnt++; rpos = 0; }
+			}
+		};
+
+		try
+		{
+			pool.push(pool.owner(offset, misplaced), group, job);
+		}
+		catch (...)
+		{
+			job(worker);
+		}
+	}
+	pool.wake();
+	pool.wait(worker, group);
+
+	return true;
+}
+
+// Hands partitions of more than grain elements to the pool, to be sorted by
+// whichever worker gets to them with that worker's own swap space, and
+// partitions arrays of more than CRUM_BLOCK elements on the pool as well
+
+template<typename T, typename Iterator>
+class crum_fork {
+public:
+	static constexpr bool parallel = true;
+
+	crum_fork(task_pool& pool, task_pool::group& group, swap_space<T>** swaps, size_t worker, size_t grain) : pool(&pool), group(&group), swaps(swaps), worker(worker), grain(grain) {}
+
+	template<typename Compare>
+	bool operator()(Iterator array, T* max, size_t nmemb, Compare cmp) const
+	{
+		if (nmemb <= grain)
+		{
+			return false;
+		}
+		task_pool* pool = this->pool;
+		task_pool::group* group = this->group;
+		swap_space<T>** swaps = this->swaps;
+		size_t grain = this->grain;
+
+		try
+		{
+			pool->push(worker, *group, [=](size_t worker)
+			{
+				fulcrum_partition<T>(array, *swaps[worker], max, nmemb, cmp, crum_fork(*pool, *group, swaps, worker, grain));
+			});
+		}
+		catch (...)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	template<typename Compare>
+	bool partition(Iterator array, T* piv, size_t nmemb, Compare cmp, size_t& a_size) const
+	{
+		if (nmemb <= CRUM_BLOCK)
+		{
+			return false;
+		}
+		return parallel_fulcrum_partition<T>(*pool, swaps, worker, array, piv, nmemb, cmp, a_size, grain);
+	}
+
+	void wait() const
+	{
+		pool->wait(worker, *group);
+	}
+
+private:
+	task_pool* pool;
+	task_pool::group* group;
+	swap_space<T>** swaps;
+	size_t worker;
+	size_t grain;
+};
+
+// crumsort() on up to threads threads, each with max_swap_size elements of
+// swap space of its own, handing out partitions of more than grain elements
+
+template<typename T, typename Iterator, typename Compare>
+void parallel_crumsort_with(parallel_backend& backend, Iterator array, size_t nmemb, size_t threads, size_t max_swap_size, Compare cmp, size_t grain = CRUM_TASK)
+{
+	if (threads <= 1 || nmemb <= grain)
+	{
+		crumsort_with<T>(array, nmemb, max_swap_size, cmp);
+		return;
+	}
+	task_pool pool(threads);
+	task_pool::group group;
+	std::vector<swap_space<T>*> swaps(threads);
+
+	pool.run(backend, [&](size_t worker)
+	{
+		stack_swap<T, CRUM_OUT> stack;
+		swap_space<T> swap(max_swap_size, CRUM_OUT, stack, array);
+		crum_fork<T, Iterator> fork(pool, group, swaps.data(), worker, grain);
+
+		swaps[worker] = &swap;
+
+		if (worker != 0)
+		{
+			pool.work(worker);
+			return;
+		}
+
+		// the partitions already handed out must be sorted before the array
+		// can be given back, even when sorting the rest threw
+
+		try
+		{
+			crum_analyze<T>(array, swap, nmemb, cmp, fork);
+		}
+		catch (...)
+		{
+			fork.wait();
+			throw;
+		}
+		fork.wait();
+	});
+}
+
+// Sample sort, which moves every element through memory a fixed number of
+// times rather than once per level of partitioning. Splitters are picked from
+// a sorted sample at the front of the array and laid out as a binary search
+// tree, so classifying an element takes one comparison per level and no
+// branches. When the sample holds duplicate splitters, every splitter also
+// gets a bucket of its own for the elements equal to it, which needs no
+// sorting. Each thread classifies a stripe of the array and counts its
+// buckets, every stripe then moves its elements to their bucket in the swap
+// space, and the buckets are moved back and sorted with crumsort_swap(), by
+// the worker they are dealt to unless another runs out of work first.
+
+template<typename T, typename Iterator, typename Compare>
+void parallel_samplesort_with(parallel_backend& backend, Iterator array, size_t nmemb, size_t threads, size_t max_swap_size, Compare cmp, size_t grain = CRUM_TASK)
+{
+	static_assert(CRUM_BUCKETS <= 32768, "bucket numbers must fit in an unsigned short");
+
+	size_t buckets = 2;
+
+	while (buckets < CRUM_BUCKETS && nmemb / (buckets * 2) >= grain)
+	{
+		buckets *= 2;
+	}
+
+	if (threads <= 1 || buckets < threads * 2 || nmemb / buckets < grain)
+	{
+		parallel_crumsort_with<T>(backend, array, nmemb, threads, max_swap_size, cmp, grain);
+		return;
+	}
+	stack_swap<T, CRUM_OUT> stack;
+	swap_space<T> scratch(nmemb, CRUM_OUT, stack, array);
+	std::vector<unsigned short> oracle;
+	std::vector<size_t> counts;
+
+	try
+	{
+		if (scratch.size() == nmemb)
+		{
+			oracle.resize(nmemb);
+			counts.resize(threads * buckets * 2);
+		}
+	}
+	catch (const std::bad_alloc&) {}
+
+	if (counts.empty())
+	{
+		parallel_crumsort_with<T>(backend, array, nmemb, threads, max_swap_size, cmp, grain);
+		return;
+	}
+
+	// a pseudo random sample, swapped to the front of the array and sorted
+
+	size_t oversample = std::max<size_t>(1, std::min<size_t>(CRUM_OVERSAMPLE, nmemb / (buckets * 2)));
+	size_t samples = buckets * oversample;
+	unsigned long long seed = nmemb;
+
+	for (size_t cnt = 0 ; cnt < samples ; cnt++)
+	{
+		seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+
+		std::iter_swap(array + cnt, array + (cnt + seed % (nmemb - cnt)));
+	}
+	crumsort_with<T>(array, samples, max_swap_size, cmp);
+
+	std::vector<const T*> splitters(buckets), tree(buckets);
+	bool equal = false;
+
+	for (size_t cnt = 0 ; cnt + 1 < buckets ; cnt++)
+	{
+		splitters[cnt] = &*(array + (cnt + 1) * oversample);
+
+		equal |= cnt && !cmp(*splitters[cnt - 1], *splitters[cnt]);
+	}
+
+	// tree[1] is the middle splitter, and tree[node * 2] and tree[node * 2 + 1]
+	// the middles of the splitters below and above tree[node]
+
+	for (size_t level = 1 ; level < buckets ; level *= 2)
+	{
+		size_t width = buckets / level;
+
+		for (size_t node = level ; node < level * 2 ; node++)
+		{
+			tree[node] = splitters[(node - level) * width + width / 2 - 1];
+		}
+	}
+
+	size_t ids = equal ? buckets * 2 : buckets;
+
+	auto classify = [&](const T& value) -> size_t
+	{
+		size_t node = 1;
+
+		while (node < buckets)
+		{
+			node = node * 2 + cmp(*tree[node], value);
+		}
+		node -= buckets;
+
+		if (equal)
+		{
+			return node * 2 + (node + 1 < buckets && !cmp(value, *splitters[node]));
+		}
+		return node;
+	};
+
+	task_pool pool(threads);
+	task_pool::group group;
+	std::vector<swap_space<T>*> swaps(threads);
+	std::vector<size_t> starts(ids + 1);
+	size_t stripes = threads;
+
+	pool.run(backend, [&](size_t worker)
+	{
+		stack_swap<T, CRUM_OUT> stack;
+		swap_space<T> swap(max_swap_size, CRUM_OUT, stack, array);
+
+		swaps[worker] = &swap;
+
+		if (worker != 0)
+		{
+			pool.work(worker);
+			return;
+		}
+
+		// runs job(task, worker) for every task on the pool, the tasks dealt out
+		// to the workers in order
+
+		auto spread = [&](const auto& job, size_t tasks)
+		{
+			for (size_t task = 0 ; task < tasks ; task++)
+			{
+				try
+				{
+					pool.push(pool.owner(task, tasks), group, [&job, task](size_t worker) { job(task, worker); });
+				}
+				catch (...)
+				{
+					job(task, 0);
+				}
+			}
+			pool.wake();
+			pool.wait(0, group);
+		};
+
+		try
+		{
+			spread([&](size_t stripe, size_t)
+			{
+				size_t* count = &counts[stripe * ids];
+
+				for (size_t cnt = nmemb * stripe / stripes ; cnt < nmemb * (stripe + 1) / stripes ; cnt++)
+				{
+					size_t id = classify(array[cnt]);
+
+					oracle[cnt] = static_cast<unsigned short>(id);
+					count[id]++;
+				}
+			}, stripes);
+
+			if (pool.failed())
+			{
+				return;
+			}
+
+			// the counts become where each stripe's part of each bucket starts
+
+			for (size_t id = 0, total = 0 ; id < ids ; id++)
+			{
+				starts[id] = total;
+
+				for (size_t stripe = 0 ; stripe < stripes ; stripe++)
+				{
+					size_t count = counts[stripe * ids + id];
+
+					counts[stripe * ids + id] = total;
+					total += count;
+				}
+			}
+			starts[ids] = nmemb;
+
+			// the swap space of each bucket is placed with the worker that sorts it
+
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				if (numa_nodes() > 1)
+				{
+					spread([&](size_t id, size_t)
+					{
+						first_touch(scratch.begin() + starts[id], scratch.begin() + starts[id + 1]);
+					}, ids);
+				}
+			}
+
+			spread([&](size_t stripe, size_t)
+			{
+				size_t* offset = &counts[stripe * ids];
+
+				for (size_t cnt = nmemb * stripe / stripes ; cnt < nmemb * (stripe + 1) / stripes ; cnt++)
+				{
+					scratch[offset[oracle[cnt]]++] = std::move(array[cnt]);
+				}
+			}, stripes);
+
+			spread([&](size_t id, size_t worker)
+			{
+				size_t start = starts[id], length = starts[id + 1] - start;
+
+				std::move(scratch.begin() + start, scratch.begin() + start + length, array + start);
+
+				if ((!equal || id % 2 == 0) && !pool.failed())
+				{
+					crumsort_swap<T>(array + start, *swaps[worker], length, cmp);
+				}
+			}, ids);
+		}
+		catch (...)
+		{
+			pool.wait(0, group);
+			throw;
+		}
+	});
+}
+
+} // namespace scandum::detail
+
+// Sorts without allocating for up to 256 elements, when 256 elements fit in
+// QUAD_STACK bytes, and can't throw when moving and comparing elements can't
+
+template<typename Iterator, typename Compare>
+void crumsort(Iterator begin, const Iterator end, Compare cmp, size_t max_swap_size = 512) noexcept(detail::is_nothrow_sortable_v<typename std::iterator_traits<Iterator>::value_type, Compare, CRUM_OUT>)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	assert(max_swap_size > 0);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::crumsort_with<T>(array, nmemb, max_swap_size, cmp);
+	});
+}
+
+// The number of bytes of scratch memory crumsort() allocates for nmemb elements of type T
+
+template<typename T>
+size_t crumsort_scratch_size(size_t nmemb, size_t max_swap_size = 512)
+{
+	return detail::swap_space_bytes<T>(nmemb <= 256 ? nmemb : std::min(nmemb, max_swap_size));
+}
+
+// Sorts using caller supplied scratch memory instead of allocating. The
+// storage may be uninitialized and unaligned, and is used up to nmemb
+// elements. Only storage too small to hold 96 elements makes the sort fall
+// back on the stack, or allocate for types too large for that.
+
+template<typename Iterator, typename Compare>
+void crumsort(Iterator begin, const Iterator end, Compare cmp, void* scratch, size_t scratch_size) noexcept(detail::is_nothrow_sortable_v<typename std::iterator_traits<Iterator>::value_type, Compare, CRUM_OUT>)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	detail::swap_space<T> swap(scratch, scratch_size, nmemb, begin);
+
+	// fulcrum_partition() hands partitions of up to CRUM_OUT elements to quadsort_swap()
+
+	if (swap.size() < std::min<size_t>(nmemb, CRUM_OUT))
+	{
+		detail::stack_swap<T, CRUM_OUT> stack;
+		detail::swap_space<T> fallback(std::min<size_t>(nmemb, CRUM_OUT), std::min<size_t>(nmemb, CRUM_OUT), stack, begin);
+
+		detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+		{
+			detail::crumsort_swap<T>(array, fallback, nmemb, cmp);
+		});
+		return;
+	}
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::crumsort_swap<T>(array, swap, nmemb, cmp);
+	});
+}
+
+// Sorts with scratch memory from alloc, which may be any allocator, instead of
+// the heap or the thread's arena. Small sorts still keep it on the stack.
+
+template<typename Iterator, typename Compare, typename Alloc, std::enable_if_t<detail::is_allocator_v<Alloc>, int> = 0>
+void crumsort(Iterator begin, const Iterator end, Compare cmp, const Alloc& alloc, size_t max_swap_size = 512)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	assert(max_swap_size > 0);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+	detail::scratch_allocator source = detail::make_scratch_allocator(alloc);
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::crumsort_with<T>(array, nmemb, max_swap_size, cmp, &source);
+	});
+}
+
+#ifdef __cpp_lib_memory_resource
+template<typename Iterator, typename Compare>
+void crumsort(Iterator begin, const Iterator end, Compare cmp, std::pmr::memory_resource* resource, size_t max_swap_size = 512)
+{
+	crumsort(begin, end, cmp, std::pmr::polymorphic_allocator<unsigned char>(resource), max_swap_size);
+}
+#endif
+
+template<typename Iterator>
+void crumsort(Iterator begin, Iterator end) noexcept(noexcept(crumsort(begin, end, std::less<typename std::iterator_traits<Iterator>::value_type>())))
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return crumsort(begin, end, std::less<T>());
+}
+
+// Sorts integers and floating point numbers in ascending order, like the C
+// crumsort_prim(), with the thresholds tuned for primitive keys picked at compile
+// time rather than with a cmp macro for the whole translation unit. NaNs
+// leave the order unspecified, as they do with std::less.
+
+template<typename Iterator>
+void crumsort_prim(Iterator begin, Iterator end) noexcept(noexcept(crumsort(begin, end, detail::prim_less<typename std::iterator_traits<Iterator>::value_type>())))
+{
+	typedef typename std::iterator_traits<Iterator>::value_type T;
+
+	static_assert(std::is_arithmetic_v<T>, "crumsort_prim() sorts integral and floating point types only");
+
+	crumsort(begin, end, detail::prim_less<T>());
+}
+
+// Sorts on up to threads threads, or on every hardware thread when threads is
+// 0. Partitions of more than CRUM_TASK elements are handed to idle threads,
+// so shorter arrays are sorted on the calling thread alone. Comparisons run
+// concurrently, and an exception from any of them is rethrown once all
+// threads are done, leaving the array in a valid but unspecified state.
+
+template<typename Iterator, typename Compare>
+void parallel_crumsort(Iterator begin, const Iterator end, Compare cmp, size_t threads = 0, size_t max_swap_size = 512)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	assert(max_swap_size > 0);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	parallel_backend& backend = get_parallel_backend();
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::parallel_crumsort_with<T>(backend, array, nmemb, threads ? threads : backend.concurrency(), max_swap_size, cmp);
+	});
+}
+
+// parallel_crumsort() on executor, handing out partitions of more than grain
+// elements. Arrays of up to grain elements are sorted on the calling thread
+// without submitting anything.
+
+template<typename Executor, typename Iterator, typename Compare, std::enable_if_t<detail::is_executor_v<Executor>, int> = 0>
+void parallel_crumsort(Executor& executor, Iterator begin, const Iterator end, Compare cmp, size_t grain = CRUM_TASK, size_t max_swap_size = 512)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	assert(grain > 0 && max_swap_size > 0);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	executor_backend<Executor> backend(executor);
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::parallel_crumsort_with<T>(backend, array, nmemb, executor.concurrency(), max_swap_size, cmp, grain);
+	});
+}
+
+template<typename Executor, typename Iterator, std::enable_if_t<detail::is_executor_v<Executor>, int> = 0>
+void parallel_crumsort(Executor& executor, Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return parallel_crumsort(executor, begin, end, std::less<T>());
+}
+
+template<typename Iterator>
+void parallel_crumsort(Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return parallel_crumsort(begin, end, std::less<T>());
+}
+
+// Sorts like parallel_crumsort(), with a sample sort for arrays of at least
+// two buckets of CRUM_TASK elements per thread, which moves every element
+// through memory a fixed number of times rather than once per partition.
+// Like parallel_quadsort(), it needs swap space for the whole array, and
+// sorts with parallel_crumsort() when that can't be allocated.
+
+template<typename Iterator, typename Compare>
+void parallel_samplesort(Iterator begin, const Iterator end, Compare cmp, size_t threads = 0, size_t max_swap_size = 512)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	assert(max_swap_size > 0);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	parallel_backend& backend = get_parallel_backend();
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::parallel_samplesort_with<T>(backend, array, nmemb, threads ? threads : backend.concurrency(), max_swap_size, cmp);
+	});
+}
+
+// parallel_samplesort() on executor, with buckets of at least grain elements
+
+template<typename Executor, typename Iterator, typename Compare, std::enable_if_t<detail::is_executor_v<Executor>, int> = 0>
+void parallel_samplesort(Executor& executor, Iterator begin, const Iterator end, Compare cmp, size_t grain = CRUM_TASK, size_t max_swap_size = 512)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	assert(grain > 0 && max_swap_size > 0);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	executor_backend<Executor> backend(executor);
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::parallel_samplesort_with<T>(backend, array, nmemb, executor.concurrency(), max_swap_size, cmp, grain);
+	});
+}
+
+template<typename Iterator>
+void parallel_samplesort(Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return parallel_samplesort(begin, end, std::less<T>());
 }
 
 } // namespace scandum
@@ -593,6 +1748,6 @@ void crumsort(Iterator begin, Iterator end)
 #undef scandum_greater
 #undef scandum_not_greater
 #undef scandum_move
-#undef scandom_conditional_assign
+#undef scandum_conditional_assign
 
 #endif
@@ -0,0 +1,80 @@
+#ifndef SCANDUM_EXECUTION_POLICY_HPP
+#define SCANDUM_EXECUTION_POLICY_HPP
+
+// Overloads of crumsort() and quadsort() that take an execution policy, like
+// std::sort() and std::stable_sort() do. The sequenced policies sort on the
+// calling thread, the parallel ones with parallel_crumsort() and
+// parallel_quadsort() on the current parallel_backend. They are kept apart
+// from the sorts because including <execution> makes some standard libraries
+// depend on TBB.
+
+#include <execution>
+#include <type_traits>
+
+#include "crumsort.hpp"
+
+namespace scandum {
+
+namespace detail {
+
+template<typename ExecutionPolicy>
+using policy_t = std::remove_cv_t<std::remove_reference_t<ExecutionPolicy>>;
+
+template<typename ExecutionPolicy>
+using enable_if_execution_policy_t = std::enable_if_t<std::is_execution_policy_v<policy_t<ExecutionPolicy>>, int>;
+
+// whether a policy asks for the calling thread alone
+
+template<typename ExecutionPolicy>
+constexpr bool is_sequenced_policy_v =
+	std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>
+#if __cpp_lib_execution >= 201902L
+	|| std::is_same_v<ExecutionPolicy, std::execution::unsequenced_policy>
+#endif
+	;
+
+} // namespace scandum::detail
+
+template<typename ExecutionPolicy, typename Iterator, typename Compare, detail::enable_if_execution_policy_t<ExecutionPolicy> = 0>
+void crumsort(ExecutionPolicy&&, Iterator begin, Iterator end, Compare cmp)
+{
+	if constexpr (detail::is_sequenced_policy_v<detail::policy_t<ExecutionPolicy>>)
+	{
+		crumsort(begin, end, cmp);
+	}
+	else
+	{
+		parallel_crumsort(begin, end, cmp);
+	}
+}
+
+template<typename ExecutionPolicy, typename Iterator, detail::enable_if_execution_policy_t<ExecutionPolicy> = 0>
+void crumsort(ExecutionPolicy&& policy, Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return crumsort(std::forward<ExecutionPolicy>(policy), begin, end, std::less<T>());
+}
+
+template<typename ExecutionPolicy, typename Iterator, typename Compare, detail::enable_if_execution_policy_t<ExecutionPolicy> = 0>
+void quadsort(ExecutionPolicy&&, Iterator begin, Iterator end, Compare cmp)
+{
+	if constexpr (detail::is_sequenced_policy_v<detail::policy_t<ExecutionPolicy>>)
+	{
+		quadsort(begin, end, cmp);
+	}
+	else
+	{
+		parallel_quadsort(begin, end, cmp);
+	}
+}
+
+template<typename ExecutionPolicy, typename Iterator, detail::enable_if_execution_policy_t<ExecutionPolicy> = 0>
+void quadsort(ExecutionPolicy&& policy, Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return quadsort(std::forward<ExecutionPolicy>(policy), begin, end, std::less<T>());
+}
+
+} // namespace scandum
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef SCANDUM_HUGE_PAGE_ALLOCATOR_HPP
+#define SCANDUM_HUGE_PAGE_ALLOCATOR_HPP
+
+// An allocator for the scratch memory of very large sorts, to be passed to
+// the allocator overloads of crumsort() and quadsort(). Blocks of at least
+// one huge page are mapped directly and backed by huge pages where the system
+// allows it, which saves the merges a TLB miss every few kilobytes as they
+// stream through gigabytes of swap space. Smaller blocks, and systems without
+// mmap(), get their memory from std::allocator.
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define SCANDUM_HAS_MMAP 1
+#endif
+
+namespace scandum {
+
+template<typename T>
+class huge_page_allocator {
+public:
+	using value_type = T;
+
+	// the huge page size mappings are aligned to and rounded up to
+
+	static constexpr size_t page_size = 2 * 1024 * 1024;
+
+	// With reserved set, allocations first try the kernel's pool of reserved
+	// huge pages (MAP_HUGETLB), which is usually empty unless configured.
+	// Either way they fall back on transparent huge pages, and then on plain
+	// pages, since the hint to use huge pages can't fail a mapping.
+
+	constexpr explicit huge_page_allocator(bool reserved = false) noexcept : reserved(reserved) {}
+
+	template<typename U>
+	constexpr huge_page_allocator(const huge_page_allocator<U>& other) noexcept : reserved(other.reserved) {}
+
+	T* allocate(size_t n)
+	{
+		if (n > static_cast<size_t>(-1) / sizeof(T))
+		{
+			throw std::bad_array_new_length();
+		}
+		size_t bytes = n * sizeof(T);
+
+		if (!is_mapped(bytes))
+		{
+			return std::allocator<T>().allocate(n);
+		}
+#ifdef SCANDUM_HAS_MMAP
+		size_t length = round_up(bytes);
+		void* block = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+		if (reserved)
+		{
+			block = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		}
+#endif
+		if (block == MAP_FAILED)
+		{
+			block = map_aligned(length);
+		}
+		if (block == MAP_FAILED)
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(block);
+#else
+		return std::allocator<T>().allocate(n);
+#endif
+	}
+
+	void deallocate(T* p, size_t n) noexcept
+	{
+		size_t bytes = n * sizeof(T);
+
+		if (!is_mapped(bytes))
+		{
+			std::allocator<T>().deallocate(p, n);
+			return;
+		}
+#ifdef SCANDUM_HAS_MMAP
+		munmap(p, round_up(bytes));
+#endif
+	}
+
+	template<typename U>
+	friend class huge_page_allocator;
+
+	template<typename U>
+	bool operator==(const huge_page_allocator<U>&) const noexcept { return true; }
+
+	template<typename U>
+	bool operator!=(const huge_page_allocator<U>&) const noexcept { return false; }
+
+private:
+	static bool is_mapped(size_t bytes)
+	{
+#ifdef SCANDUM_HAS_MMAP
+		return bytes >= page_size;
+#else
+		return (void) bytes, false;
+#endif
+	}
+
+	static size_t round_up(size_t bytes)
+	{
+		return (bytes + page_size - 1) & ~(page_size - 1);
+	}
+
+#ifdef SCANDUM_HAS_MMAP
+	// Transparent huge pages only back the parts of a mapping that are aligned
+	// to the huge page size, so map one huge page extra and trim it to fit.
+
+	static void* map_aligned(size_t length)
+	{
+		void* mapping = mmap(nullptr, length + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (mapping == MAP_FAILED)
+		{
+			return MAP_FAILED;
+		}
+		char* start = static_cast<char*>(mapping);
+		char* aligned = reinterpret_cast<char*>(round_up(reinterpret_cast<size_t>(start)));
+		size_t head = aligned - start;
+
+		if (head)
+		{
+			munmap(start, head);
+		}
+		munmap(aligned + length, page_size - head);
+
+#ifdef MADV_HUGEPAGE
+		madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+		return aligned;
+	}
+#endif
+
+	bool reserved;
+};
+
+} // namespace scandum
+
+#undef SCANDUM_HAS_MMAP
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef SCANDUM_PROJECTION_HPP
+#define SCANDUM_PROJECTION_HPP
+
+// Overloads of crumsort() and quadsort() that compare a projection of each
+// element, like std::ranges::sort() does, such as a member or a key derived
+// from a record. Arithmetic keys of up to 32 bits compared with std::less or
+// std::greater, of records several times their size, are projected once and
+// sorted apart with the index of their record, after which the records are
+// moved into place. Other keys are projected on every comparison: wider keys
+// can't be packed with their index into an integer the primitive kernels
+// sort, and sorting them in pairs was found to be slower than sorting the
+// records.
+
+#include <cstdint>
+#include <cstring>     // for std::memcpy
+#include <functional>  // for std::invoke
+#include <memory>
+#include <new>         // for std::nothrow
+#include <type_traits>
+#include <utility>
+
+#include "crumsort.hpp"
+
+// Keys are cached for records at least this many times the size of a cached
+// key and its index, 8 bytes, in arrays of more than PROJ_CACHE_MIN records
+
+#ifndef PROJ_CACHE
+#define PROJ_CACHE 2
+#endif
+
+#ifndef PROJ_CACHE_MIN
+#define PROJ_CACHE_MIN 256
+#endif
+
+namespace scandum {
+
+namespace detail {
+
+template<typename T, typename Projection>
+using projected_t = std::decay_t<std::invoke_result_t<Projection&, T&>>;
+
+template<typename Compare, typename Projection>
+struct projected_compare {
+	template<typename L, typename R>
+	decltype(auto) operator()(L&& lhs, R&& rhs) const noexcept(noexcept(std::invoke(std::declval<Compare&>(), std::invoke(std::declval<Projection&>(), lhs), std::invoke(std::declval<Projection&>(), rhs))))
+	{
+		return std::invoke(cmp, std::invoke(proj, lhs), std::invoke(proj, rhs));
+	}
+
+	mutable Compare cmp;
+	mutable Projection proj;
+};
+
+template<typename T, typename Key, typename Compare>
+constexpr bool is_cached_key_v =
+	is_prim_compare_v<known_compare_t<Key, Compare>> && sizeof(Key) <= 4 &&
+	std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T> &&
+	sizeof(T) >= PROJ_CACHE * sizeof(std::uint64_t);
+
+// the key as a 32 bit unsigned integer in the order of the comparison, with
+// -0.0 taken for 0.0, which compares equal to it
+
+template<typename Key, bool Descending>
+std::uint32_t key_bits(Key key) noexcept
+{
+	constexpr std::uint32_t sign = 0x80000000;
+	std::uint32_t bits;
+
+	if constexpr (std::is_floating_point_v<Key>)
+	{
+		key = key == 0 ? Key() : key;
+
+		std::memcpy(&bits, &key, sizeof(Key));
+
+		bits = bits & sign ? ~bits : bits | sign;
+	}
+	else if constexpr (std::is_signed_v<Key>)
+	{
+		bits = static_cast<std::uint32_t>(static_cast<std::int32_t>(key)) ^ sign;
+	}
+	else
+	{
+		bits = static_cast<std::uint32_t>(key);
+	}
+	return Descending ? ~bits : bits;
+}
+
+// Moves the records into the order of the indices, following each cycle of
+// the permutation, and marks every index done by setting it to its own
+// position
+
+template<typename T, typename Iterator, typename Index>
+void permute(Iterator array, size_t nmemb, Index index)
+{
+	for (size_t cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		if (index(cnt) == cnt)
+		{
+			continue;
+		}
+		T temp = std::move(array[cnt]);
+		size_t pos = cnt, next;
+
+		while ((next = static_cast<size_t>(index(pos))) != cnt)
+		{
+			array[pos] = std::move(array[next]);
+			index(pos) = pos;
+			pos = next;
+		}
+		array[pos] = std::move(temp);
+		index(pos) = pos;
+	}
+}
+
+// Sorts the records by keys projected once, returning false when there is no
+// memory for them. Each key is packed with the index of its record into a 64
+// bit integer, which the primitive kernels sort, and the index keeps the
+// records of equal keys in order.
+
+template<typename T, typename Iterator, typename Compare, typename Projection>
+bool sort_cached(Iterator array, size_t nmemb, Projection& proj)
+{
+	typedef projected_t<T, Projection> Key;
+
+	constexpr bool descending = std::is_same_v<known_compare_t<Key, Compare>, prim_greater<Key>>;
+
+	if (nmemb > 0xffffffff)
+	{
+		return false;
+	}
+	std::unique_ptr<std::uint64_t[]> keys(new (std::nothrow) std::uint64_t[nmemb]);
+
+	if (!keys)
+	{
+		return false;
+	}
+
+	for (size_t cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		keys[cnt] = static_cast<std::uint64_t>(key_bits<Key, descending>(std::invoke(proj, array[cnt]))) << 32 | cnt;
+	}
+	crumsort(keys.get(), keys.get() + nmemb, prim_less<std::uint64_t>());
+
+	for (size_t cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		keys[cnt] &= 0xffffffff;
+	}
+	permute<T>(array, nmemb, [&](size_t cnt) -> std::uint64_t& { return keys[cnt]; });
+
+	return true;
+}
+
+template<typename T, typename Projection>
+using enable_if_projection_t = std::enable_if_t<std::is_invocable_v<Projection&, T&>, int>;
+
+} // namespace scandum::detail
+
+// Sorts by the projection of each element, comparing the projections with
+// cmp
+
+template<typename Iterator, typename Compare, typename Projection, detail::enable_if_projection_t<std::remove_reference_t<decltype(*std::declval<Iterator>())>, Projection> = 0>
+void crumsort(Iterator begin, Iterator end, Compare cmp, Projection proj)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	if constexpr (detail::is_cached_key_v<T, detail::projected_t<T, Projection>, Compare>)
+	{
+		if (nmemb > PROJ_CACHE_MIN && detail::sort_cached<T, Iterator, Compare>(begin, nmemb, proj))
+		{
+			return;
+		}
+	}
+	crumsort(begin, end, detail::projected_compare<Compare, Projection> { cmp, proj });
+}
+
+// Sorts by the projection of each element, keeping elements with equal
+// projections in order
+
+template<typename Iterator, typename Compare, typename Projection, detail::enable_if_projection_t<std::remove_reference_t<decltype(*std::declval<Iterator>())>, Projection> = 0>
+void quadsort(Iterator begin, Iterator end, Compare cmp, Projection proj)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	if constexpr (detail::is_cached_key_v<T, detail::projected_t<T, Projection>, Compare>)
+	{
+		if (nmemb > PROJ_CACHE_MIN && detail::sort_cached<T, Iterator, Compare>(begin, nmemb, proj))
+		{
+			return;
+		}
+	}
+	quadsort(begin, end, detail::projected_compare<Compare, Projection> { cmp, proj });
+}
+
+} // namespace scandum
+
+#endif
@@ -4,15 +4,73 @@
 // quadsort 1.2.1.3 - Igor van den Hoven ivdhoven@gmail.com
 
 #include <algorithm>   // for std::copy and std::copy_backward
+#include <atomic>
 #include <cassert>
-#include <optional>
+#if __cplusplus >= 202002L
+#include <compare>     // for std::strong_ordering and std::weak_ordering
+#endif
+#include <condition_variable>
+#include <cstddef>     // for std::max_align_t
+#include <deque>
+#include <exception>
+#include <functional>  // for std::less, std::greater and std::function
+#include <limits>
+#include <memory>      // for std::align and the uninitialized memory algorithms
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#include <mutex>
+#include <new>         // for std::launder, std::nothrow and std::bad_alloc
+#include <thread>
 #include <type_traits>
 #include <vector>
 
+// Define SCANDUM_NUMA, and link with libnuma, to place the work of the
+// parallel sorts on the NUMA node that holds its memory
+
+#ifdef SCANDUM_NUMA
+#include <numa.h>
+#include <sched.h>
+#endif
+
+// Primitive keys are sorted with AVX2 or AVX-512 kernels on x86-64 processors
+// that have them, picked at run time. Define SCANDUM_NO_SIMD to sort them with
+// scalar code alone.
+
+#if !defined SCANDUM_NO_SIMD && (defined __x86_64__ || defined _M_X64)
+#define SCANDUM_SIMD
+#include <immintrin.h>
+#if defined _MSC_VER && !defined __clang__
+#include <intrin.h>
+#define SCANDUM_TARGET_AVX2
+#define SCANDUM_TARGET_AVX512
+#define SCANDUM_INLINE_AVX2 __forceinline
+#define SCANDUM_INLINE_AVX512 __forceinline
+#else
+#define SCANDUM_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define SCANDUM_TARGET_AVX512 __attribute__((target("avx512f,avx2,popcnt")))
+#define SCANDUM_INLINE_AVX2 __attribute__((target("avx2,popcnt"), always_inline)) inline
+#define SCANDUM_INLINE_AVX512 __attribute__((target("avx512f,avx2,popcnt"), always_inline)) inline
+#endif
+#endif
+
+// Small sorts keep their swap space on the stack, in up to this many bytes
+
+#ifndef QUAD_STACK
+#define QUAD_STACK 8192
+#endif
+
+// The parallel sorts split the array into runs and merges of at least this
+// many elements per thread
+
+#ifndef QUAD_TASK
+#define QUAD_TASK 65536
+#endif
+
 // comparison functions
 
 #define scandum_greater(less, lhs, rhs) less(rhs, lhs)
-#define scandum_not_greater(less, lhs, rhs) (less(lhs, rhs) || !less(rhs, lhs))
+#define scandum_not_greater(less, lhs, rhs) ::scandum::detail::not_greater(less, lhs, rhs)
 
 // universal copy functions to handle both trivially and nontrivially copyable types
 
@@ -41,14 +99,21 @@
 
 // utilize branchless ternary operations in clang
 
+// the double write merges move from an element before knowing whether it is
+// the one being merged, which is only harmless for trivially copyable types
+
 #if !defined __clang__
 #define scandum_head_branchless_merge(ptd, x, ptl, ptr, cmp)  \
+	if constexpr (std::is_trivially_copyable_v<T>) {  \
 	x = scandum_not_greater(cmp, *ptl, *ptr);  \
 	*ptd = scandum_move(*ptl);  \
 	ptl += x;  \
 	ptd[x] = scandum_move(*ptr);  \
 	ptr += !x;  \
-	ptd++;
+	ptd++;  \
+	} else {  \
+	*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? (T&)*ptl++ : (T&)*ptr++);  \
+	}
 #else
 #define scandum_head_branchless_merge(ptd, x, ptl, ptr, cmp)  \
 	*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? (T&)*ptl++ : (T&)*ptr++);
@@ -56,12 +121,16 @@
 
 #if !defined __clang__
 #define scandum_tail_branchless_merge(tpd, y, tpl, tpr, cmp)  \
+	if constexpr (std::is_trivially_copyable_v<T>) {  \
 	y = scandum_not_greater(cmp, *tpl, *tpr);  \
 	*tpd = scandum_move(*tpl);  \
 	tpl -= !y;  \
 	tpd--;  \
 	tpd[y] = scandum_move(*tpr);  \
-	tpr -= y;
+	tpr -= y;  \
+	} else {  \
+	*tpd-- = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? (T&)*tpl-- : (T&)*tpr--);  \
+	}
 #else
 #define scandum_tail_branchless_merge(tpd, x, tpl, tpr, cmp)  \
 	*tpd-- = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? (T&)*tpl-- : (T&)*tpr--);
@@ -89,1238 +158,3875 @@
 	scandum_tail_branchless_merge(pts, x, ptl, ptr, cmp);  \
 	*pts = scandum_move(scandum_greater(cmp, *ptl, *ptr) ? (T&)*ptl : (T&)*ptr);
 
+// order a pair, x being whether it is out of order; the branchless version
+// moves an element onto itself when it is not, so other types take a branch
+
+#define scandum_swap_pair(pta, swap, x)  \
+	if constexpr (std::is_trivially_copyable_v<T>) {  \
+	swap = scandum_move(pta[!(x)]);  \
+	pta[0] = scandum_move(pta[x]);  \
+	pta[1] = scandum_move(swap);  \
+	} else if (x) {  \
+	swap = scandum_move(pta[0]);  \
+	pta[0] = scandum_move(pta[1]);  \
+	pta[1] = scandum_move(swap);  \
+	}
+
 #if !defined __clang__
-#define scandum_branchless_swap(pta, swap, x, cmp)  \
+#define scandum_generic_branchless_swap(pta, swap, x, cmp)  \
 	x = scandum_greater(cmp, *pta, *(pta + 1));  \
-	swap = scandum_move(pta[!x]);  \
-	pta[0] = scandum_move(pta[x]);  \
-	pta[1] = scandum_move(swap);
+	scandum_swap_pair(pta, swap, x);
 #else
-#define scandum_branchless_swap(pta, swap, x, cmp)  \
+#define scandum_generic_branchless_swap(pta, swap, x, cmp)  \
+	if constexpr (std::is_trivially_copyable_v<T>) {  \
 	x = 0;  \
 	swap = scandum_move(scandum_greater(cmp, *pta, *(pta + 1)) ? pta[x++] : pta[1]);  \
 	pta[0] = scandum_move(pta[x]);  \
-	pta[1] = scandum_move(swap);
+	pta[1] = scandum_move(swap);  \
+	} else {  \
+	x = scandum_greater(cmp, *pta, *(pta + 1));  \
+	scandum_swap_pair(pta, swap, x);  \
+	}
 #endif
 
+// primitive keys are ordered with a min and a max, which need no branches
+// and no round trip through memory
+
+#define scandum_branchless_swap(pta, swap, x, cmp)  \
+	if constexpr (::scandum::detail::is_prim_compare_v<decltype(cmp)>) {  \
+	x = ::scandum::detail::prim_swap(pta, cmp);  \
+	} else {  \
+	scandum_generic_branchless_swap(pta, swap, x, cmp)  \
+	}
+
 #define scandum_swap_branchless(pta, swap, x, y, cmp)  \
 	x = scandum_greater(cmp, *pta, *(pta + 1));  \
 	y = !x;  \
-	swap = scandum_move(pta[y]);  \
-	pta[0] = scandum_move(pta[x]);  \
-	pta[1] = scandum_move(swap);
-
+	scandum_swap_pair(pta, swap, x);
 
 namespace scandum {
 
-namespace detail {
-
-template<typename T>
-struct deferred_construct : public std::optional<T> {
-	deferred_construct() {}
-	deferred_construct(const T& value) : std::optional<T>(value) {}
-	deferred_construct(T&& value) : std::optional<T>(std::forward<T>(value)) {}
-	constexpr operator T&() { return **this; }
-	constexpr operator const T&() const { return **this; }
-};
+// The vector instruction sets the kernels for primitive keys come in. Any
+// other x86-64 processor, SSE4.2 included, and any other architecture, sorts
+// them with scalar code.
 
-template<typename T>
-struct swap_vector : public std::vector<T> {
-	using base_type = std::vector<T>;
-	using iterator = T*;
-	explicit swap_vector(size_t n) : base_type(n) {}
-	constexpr T* begin() { return base_type::data(); }
-	constexpr T* end() { return base_type::data() + base_type::size(); }
-};
+enum class simd_isa { scalar, avx2, avx512 };
 
-template<typename T>
-using swap_space = std::conditional_t<
-	std::is_default_constructible_v<T>,
-	swap_vector<T>,
-	swap_vector<deferred_construct<T>>
->;
+namespace detail {
 
-template<typename T>
-using temp_var = std::conditional_t<
-	std::is_default_constructible_v<T>,
-	T,
-	deferred_construct<T>
->;
+// NUMA placement, which can be switched off at run time to measure what it
+// gains. Without it every thread is taken to be on node 0.
 
-// the next seven functions are used for sorting 0 to 31 elements
+#ifdef SCANDUM_NUMA
+inline std::atomic<bool> numa_enabled { numa_available() >= 0 && numa_num_configured_nodes() > 1 };
 
-template<typename T, typename Iterator, typename Compare>
-void parity_swap_four(Iterator array, Compare cmp)
+inline size_t numa_nodes()
 {
-	temp_var<T> tmp;
-	Iterator pta = array;
-	size_t x;
-
-	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta--;
+	return numa_enabled.load(std::memory_order_relaxed) ? numa_num_configured_nodes() : 1;
+}
 
-	if (scandum_greater(cmp, *pta, *(pta + 1)))
+inline size_t numa_node()
+{
+	if (!numa_enabled.load(std::memory_order_relaxed))
 	{
-		tmp = scandum_move(pta[0]); pta[0] = scandum_move(pta[1]); pta[1] = scandum_move(tmp); pta--;
-
-		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-		scandum_branchless_swap(pta, tmp, x, cmp); pta--;
-		scandum_branchless_swap(pta, tmp, x, cmp);
+		return 0;
 	}
+	int cpu = sched_getcpu();
+	int node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+
+	return node > 0 ? node : 0;
 }
 
-template<typename T, typename Iterator, typename Compare>
-void parity_swap_five(Iterator array, Compare cmp)
+inline void numa_bind(size_t node)
 {
-	temp_var<T> tmp;
-	Iterator pta = array;
-	size_t x, y;
-
-	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-	scandum_branchless_swap(pta, tmp, y, cmp); pta = array;
-
-	if (x + y)
+	if (numa_enabled.load(std::memory_order_relaxed))
 	{
-		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-		scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1;
-		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-		scandum_branchless_swap(pta, tmp, x, cmp); pta = array;
-		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-		scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1;
+		numa_run_on_node(static_cast<int>(node));
 	}
 }
+#else
+inline std::atomic<bool> numa_enabled { false };
 
-template<typename T, typename Iterator, typename Compare>
-void parity_swap_six(Iterator array, swap_space<T>& swap, Compare cmp)
-{
-	temp_var<T> tmp;
-	Iterator pta = array;
-	typename swap_space<T>::iterator ptl;
-	typename swap_space<T>::iterator ptr;
-	size_t x, y;
+inline size_t numa_nodes() { return 1; }
+inline size_t numa_node() { return 0; }
+inline void numa_bind(size_t) {}
+#endif
 
-	scandum_branchless_swap(pta, tmp, x, cmp); pta++;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta += 3;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta--;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta = array;
+} // namespace scandum::detail
 
-	if (scandum_not_greater(cmp, *(pta + 2), *(pta + 3)))
+// The thread pool the parallel sorts run on. run() calls body(worker) once
+// for every worker from 0 to workers - 1, and returns once all calls have.
+// Worker 0 runs on the calling thread and the others are meant to run
+// alongside it, but a pool with no threads to spare may also run them on the
+// calling thread after worker 0; the sorts still finish, on fewer threads.
+// body never throws.
+
+class parallel_backend {
+public:
+	virtual ~parallel_backend() = default;
+
+	// the number of workers the sorts start when not told otherwise
+
+	virtual size_t concurrency() const = 0;
+
+	virtual void run(size_t workers, const std::function<void(size_t)>& body) = 0;
+};
+
+// The built-in backend, which starts a thread for every worker but the first
+// on each run, and runs the workers it can't start a thread for on the
+// calling thread. With NUMA placement the threads are spread evenly over the
+// nodes, neighbouring workers sharing a node.
+
+class thread_backend : public parallel_backend {
+public:
+	size_t concurrency() const override
 	{
-		scandum_branchless_swap(pta, tmp, x, cmp); pta += 4;
-		scandum_branchless_swap(pta, tmp, x, cmp);
-		return;
+		size_t threads = std::thread::hardware_concurrency();
+
+		return threads ? threads : 1;
 	}
-	x = scandum_greater(cmp, *pta, *(pta + 1));
-	y = !x;
-	swap[0] = scandum_move(pta[x]);
-	swap[1] = scandum_move(pta[y]);
-	swap[2] = scandum_move(pta[2]);
-	pta += 4;
-	x = scandum_greater(cmp, *pta, *(pta + 1));
-	y = !x;
-	swap[4] = scandum_move(pta[x]);
-	swap[5] = scandum_move(pta[y]);
-	swap[3] = scandum_move(pta[-1]);
 
-	pta = array; ptl = swap.begin(); ptr = swap.begin() + 3;
+	void run(size_t workers, const std::function<void(size_t)>& body) override
+	{
+		std::vector<std::thread> threads;
+		size_t worker = 1, nodes = detail::numa_nodes();
 
-	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
-	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
-	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+		try
+		{
+			threads.reserve(workers - 1);
 
-	pta = array + 5; ptl = swap.begin() + 2; ptr = swap.begin() + 5;
+			for ( ; worker < workers ; worker++)
+			{
+				threads.emplace_back([&body, worker, workers, nodes]
+				{
+					if (nodes > 1)
+					{
+						detail::numa_bind(worker * nodes / workers);
+					}
+					body(worker);
+				});
+			}
+		}
+		catch (...) {}
 
-	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
-	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
-	*pta = scandum_move(scandum_greater(cmp, *ptl, *ptr) ? *ptl : *ptr);
-}
+		body(0);
 
-template<typename T, typename Iterator, typename Compare>
-void parity_swap_seven(Iterator array, swap_space<T>& swap, Compare cmp)
-{
-	temp_var<T> tmp;
-	Iterator pta = array;
-	typename swap_space<T>::iterator ptl;
-	typename swap_space<T>::iterator ptr;
-	size_t x, y;
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		for ( ; worker < workers ; worker++)
+		{
+			body(worker);
+		}
+	}
+};
 
-	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta -= 3;
-	scandum_branchless_swap(pta, tmp, y, cmp); pta += 2;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2; y += x;
-	scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1; y += x;
+namespace detail {
 
-	if (y == 0) return;
+inline thread_backend default_backend;
+inline std::atomic<parallel_backend*> current_backend { nullptr };
 
-	scandum_branchless_swap(pta, tmp, x, cmp); pta = array;
+// Scratch objects are brought to life in one of three ways. Trivially copyable
+// types live directly in raw storage, other default constructible types are
+// default constructed, and the rest are move constructed from an element of
+// the array which is then moved straight back, leaving a valid object behind.
 
-	x = scandum_greater(cmp, *pta, *(pta + 1));
-	swap[0] = scandum_move(pta[x]);
-	swap[1] = scandum_move(pta[!x]);
-	swap[2] = scandum_move(pta[2]);
-	pta += 3;
-	x = scandum_greater(cmp, *pta, *(pta + 1));
-	swap[3] = scandum_move(pta[x]);
-	swap[4] = scandum_move(pta[!x]);
-	pta += 2;
-	x = scandum_greater(cmp, *pta, *(pta + 1));
-	swap[5] = scandum_move(pta[x]);
-	swap[6] = scandum_move(pta[!x]);
+template<typename T>
+constexpr bool is_raw_storage_v = std::is_trivially_copyable_v<T>;
 
-	pta = array; ptl = swap.begin(); ptr = swap.begin() + 3;
+template<typename T, typename Iterator>
+void construct_scratch(T* slot, Iterator exemplar)
+{
+	if constexpr (std::is_default_constructible_v<T>)
+	{
+		::new (static_cast<void*>(slot)) T;
+	}
+	else
+	{
+		::new (static_cast<void*>(slot)) T(scandum_move(*exemplar));
 
-	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
-	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
-	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+		*exemplar = scandum_move(*slot);
+	}
+}
 
-	pta = array + 6; ptl = swap.begin() + 2; ptr = swap.begin() + 6;
+// a single temporary, like the pivot or the swap variable of a rotation
 
-	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
-	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
-	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
-	*pta = scandum_move(scandum_greater(cmp, *ptl, *ptr) ? *ptl : *ptr);
-}
+template<typename T, bool = std::is_default_constructible_v<T>>
+class temp_var {
+public:
+	template<typename Iterator>
+	explicit temp_var(Iterator) {}
 
-template<typename T, typename Iterator, typename Compare>
-void tiny_sort(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
-{
-	temp_var<T> tmp;
-	size_t x;
+	constexpr operator T&() { return value; }
 
-	switch (nmemb)
+private:
+	T value;
+};
+
+template<typename T>
+class temp_var<T, false> {
+public:
+	template<typename Iterator>
+	explicit temp_var(Iterator exemplar)
 	{
-		case 0:
-		case 1:
-			return;
-		case 2:
-			scandum_branchless_swap(array, tmp, x, cmp);
-			return;
-		case 3:
-			scandum_branchless_swap(array, tmp, x, cmp); array++;
-			scandum_branchless_swap(array, tmp, x, cmp); array--;
-			scandum_branchless_swap(array, tmp, x, cmp);
-			return;
-		case 4:
-			parity_swap_four<T>(array, cmp);
-			return;
-		case 5:
-			parity_swap_five<T>(array, cmp);
-			return;
-		case 6:
-			parity_swap_six<T>(array, swap, cmp);
-			return;
-		case 7:
-			parity_swap_seven<T>(array, swap, cmp);
-			return;
+		if constexpr (!is_raw_storage_v<T>) construct_scratch(get(), exemplar);
 	}
-}
 
-// left must be equal or one smaller than right
+	temp_var(const temp_var&) = delete;
+	temp_var& operator=(const temp_var&) = delete;
 
-template<typename T, typename OutputIt, typename InputIt, typename Compare>
-void parity_merge(OutputIt dest, InputIt from, size_t left, size_t right, Compare cmp)
+	~temp_var()
+	{
+		get()->~T();
+	}
+
+	operator T&() { return *get(); }
+
+private:
+	T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+	alignas(T) unsigned char storage[sizeof(T)];
+};
+
+// the number of bytes of caller supplied storage needed to hold nmemb
+// elements of swap space, including any padding lost to alignment
+
+template<typename T>
+constexpr size_t swap_space_bytes(size_t nmemb)
 {
-#if !defined __clang__
-	size_t x, y;
-#endif
-	InputIt ptl = from;
-	InputIt ptr = from + left;
-	OutputIt ptd = dest;
-	InputIt tpl = ptr - 1;
-	InputIt tpr = tpl + right;
-	OutputIt tpd = dest + left + right - 1;
+	return nmemb * sizeof(T) + alignof(T) - 1;
+}
 
-	if (left < right)
+// A per-thread stack of scratch memory that swap spaces borrow from instead
+// of the heap. It is disabled until a limit is set, and it only grows while
+// no sort on its thread is using it, to the largest total demand it has seen
+// so far, capped at the limit. Requests it can't serve go to the heap.
+
+class scratch_arena {
+public:
+	scratch_arena() = default;
+	scratch_arena(const scratch_arena&) = delete;
+	scratch_arena& operator=(const scratch_arena&) = delete;
+
+	~scratch_arena()
 	{
-		*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+		::operator delete(buffer);
 	}
-	*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
 
-#if !defined cmp && !defined __clang__ // cache limit workaround for gcc
-	if (left > QUAD_CACHE)
+	void* acquire(size_t bytes)
 	{
-		while (--left)
+		bytes = round_up(bytes);
+
+		if (bytes > capacity - used)
 		{
-			*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
-			*tpd-- = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? *tpl-- : *tpr--);
+			demand = std::max(demand, used + bytes);
+
+			if (used || bytes > limit || !grow(std::min(demand, limit)))
+			{
+				return nullptr;
+			}
 		}
+		void* block = buffer + used;
+
+		used += bytes;
+
+		return block;
 	}
-	else
-#endif
+
+	// blocks are handed back in the reverse order they were acquired in
+
+	void give_back(size_t bytes)
 	{
-		while (--left)
-		{
-			scandum_head_branchless_merge(ptd, x, ptl, ptr, cmp);
-			scandum_tail_branchless_merge(tpd, y, tpl, tpr, cmp);
-		}
+		used -= round_up(bytes);
 	}
-	*tpd = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? *tpl : *tpr);
-}
 
-template<typename T, typename Iterator, typename Compare>
-void tail_swap(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
-{
-	if (nmemb < 8)
+	void set_limit(size_t bytes)
 	{
-		tiny_sort<T>(array, swap, nmemb, cmp);
-		return;
+		limit = bytes;
+
+		trim(bytes);
 	}
-	size_t quad1, quad2, quad3, quad4, half1, half2;
 
-	half1 = nmemb / 2;
-	quad1 = half1 / 2;
-	quad2 = half1 - quad1;
-	half2 = nmemb - half1;
-	quad3 = half2 / 2;
-	quad4 = half2 - quad3;
+	void trim(size_t bytes)
+	{
+		demand = std::min(demand, bytes);
 
-	Iterator pta = array;
+		if (used == 0 && capacity > bytes)
+		{
+			::operator delete(buffer);
 
-	tail_swap<T>(pta, swap, quad1, cmp); pta += quad1;
-	tail_swap<T>(pta, swap, quad2, cmp); pta += quad2;
-	tail_swap<T>(pta, swap, quad3, cmp); pta += quad3;
-	tail_swap<T>(pta, swap, quad4, cmp);
+			buffer = nullptr;
+			capacity = 0;
+		}
+	}
 
-	if (scandum_not_greater(cmp, *(array + quad1 - 1), *(array + quad1)) && scandum_not_greater(cmp, *(array + half1 - 1), *(array + half1)) && scandum_not_greater(cmp, *(pta - 1), *pta))
+	size_t size() const
 	{
-		return;
+		return capacity;
 	}
-	parity_merge<T>(swap.begin(), array, quad1, quad2, cmp);
-	parity_merge<T>(swap.begin() + half1, array + half1, quad3, quad4, cmp);
-	parity_merge<T>(array, swap.begin(), half1, half2, cmp);
-}
 
-// the next three functions create sorted blocks of 32 elements
+private:
+	static size_t round_up(size_t bytes)
+	{
+		return (bytes + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+	}
 
-template<typename T, typename Iterator>
-void quad_reversal(Iterator pta, Iterator ptz)
-{
-	Iterator ptb, pty;
-	temp_var<T> tmp1, tmp2;
+	bool grow(size_t bytes)
+	{
+		void* block = ::operator new(bytes, std::nothrow);
 
-	size_t loop = (ptz - pta) / 2;
+		if (block == nullptr)
+		{
+			return false;
+		}
+		::operator delete(buffer);
 
-	ptb = pta + loop;
-	pty = ptz - loop;
+		buffer = static_cast<unsigned char*>(block);
+		capacity = bytes;
 
-	if (loop % 2 == 0)
-	{
-		tmp2 = scandum_move(*ptb); *ptb-- = scandum_move(*pty); *pty++ = scandum_move(tmp2); loop--;
+		return true;
 	}
 
-	loop /= 2;
+	unsigned char* buffer = nullptr;
+	size_t capacity = 0;
+	size_t used = 0;
+	size_t demand = 0;
+	size_t limit = 0;
+};
 
-	do
-	{
-		tmp1 = scandum_move(*pta); *pta++ = scandum_move(*ptz); *ptz-- = scandum_move(tmp1);
-		tmp2 = scandum_move(*ptb); *ptb-- = scandum_move(*pty); *pty++ = scandum_move(tmp2);
-	} while (loop--);
-}
+inline thread_local scratch_arena thread_arena;
 
-template<typename T, typename Iterator, typename Compare>
-void quad_swap_merge(Iterator array, swap_space<T>& swap, Compare cmp)
-{
-	typename swap_space<T>::iterator pts;
-	Iterator ptl;
-	Iterator ptr;
-#if !defined __clang__
-	size_t x;
-#endif
-	scandum_parity_merge_two(array + 0, swap.begin() + 0, x, ptl, ptr, pts, cmp);
-	scandum_parity_merge_two(array + 4, swap.begin() + 4, x, ptl, ptr, pts, cmp);
+// uninitialized stack storage for up to N elements of swap space, as many as
+// fit in QUAD_STACK bytes
 
-	Iterator pts2;
-	typename swap_space<T>::iterator ptl2;
-	typename swap_space<T>::iterator ptr2;
-	scandum_parity_merge_four(swap.begin(), array, x, ptl2, ptr2, pts2, cmp);
-}
+template<typename T, size_t N>
+class stack_swap {
+public:
+	static constexpr size_t capacity = std::min(N, QUAD_STACK / sizeof(T));
 
-template<typename T, typename Iterator, typename Compare>
-void partial_backward_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp);
+	void* data() { return storage; }
 
-template<typename T, typename Iterator, typename Compare>
-void tail_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
-{
-	Iterator pta, pte;
+private:
+	alignas(T) unsigned char storage[capacity ? capacity * sizeof(T) : 1];
+};
 
-	pte = array + nmemb;
+// A caller supplied allocator, with its type erased so that swap spaces of
+// every element type can allocate raw bytes from it
 
-	while (block < nmemb && block <= swap.size())
-	{
-		for (pta = array ; block < pte - pta; pta += block * 2)
-		{
-			if (block * 2 < pte - pta)
-			{
-				partial_backward_merge<T>(pta, swap, block * 2, block, cmp);
+struct scratch_allocator {
+	const void* context;
+	void* (*allocate)(const void* context, size_t bytes);
+	void (*deallocate)(const void* context, void* block, size_t bytes);
+};
 
-				continue;
-			}
-			partial_backward_merge<T>(pta, swap, pte - pta, block, cmp);
+template<typename Alloc, typename = void>
+struct is_allocator : std::false_type {};
 
-			break;
-		}
-		block *= 2;
-	}
-}
+template<typename Alloc>
+struct is_allocator<Alloc, std::void_t<typename Alloc::value_type, decltype(std::declval<Alloc&>().allocate(size_t()))>> : std::true_type {};
 
-template<typename T, typename Iterator, typename Compare>
-size_t quad_swap(Iterator array, size_t nmemb, Compare cmp)
-{
-	temp_var<T> tmp;
-	size_t count;
-	Iterator pta, pts;
-	unsigned char v1, v2, v3, v4, x;
-	pta = array;
+template<typename Alloc>
+constexpr bool is_allocator_v = is_allocator<Alloc>::value;
 
-	swap_space<T> swap(32);
+// whether a type meets the executor interface the parallel sorts accept
 
-	count = nmemb / 8;
+template<typename Executor, typename = void>
+struct is_executor : std::false_type {};
 
-	while (count--)
-	{
-		v1 = scandum_greater(cmp, *(pta + 0), *(pta + 1));
-		v2 = scandum_greater(cmp, *(pta + 2), *(pta + 3));
-		v3 = scandum_greater(cmp, *(pta + 4), *(pta + 5));
-		v4 = scandum_greater(cmp, *(pta + 6), *(pta + 7));
+template<typename Executor>
+struct is_executor<Executor, std::void_t<typename Executor::task_group,
+	decltype(std::declval<const Executor&>().concurrency()),
+	decltype(std::declval<Executor&>().submit(std::declval<typename Executor::task_group&>(), std::function<void()>())),
+	decltype(std::declval<Executor&>().wait(std::declval<typename Executor::task_group&>()))>> : std::true_type {};
 
-		switch (v1 + v2 * 2 + v3 * 4 + v4 * 8)
-		{
-			case 0:
-				if (scandum_not_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_not_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_not_greater(cmp, *(pta + 5), *(pta + 6)))
-				{
-					goto ordered;
-				}
-				quad_swap_merge<T>(pta, swap, cmp);
-				break;
+template<typename Executor>
+constexpr bool is_executor_v = is_executor<Executor>::value;
 
-			case 15:
-				if (scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
-				{
-					pts = pta;
-					goto reversed;
-				}
+template<typename Alloc>
+scratch_allocator make_scratch_allocator(const Alloc& alloc)
+{
+	using byte_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<unsigned char>;
+	using traits = std::allocator_traits<byte_alloc>;
 
-			default:
-			not_ordered:
-				x = !v1; tmp = scandum_move(pta[x]); pta[0] = scandum_move(pta[v1]); pta[1] = scandum_move(tmp); pta += 2;
-				x = !v2; tmp = scandum_move(pta[x]); pta[0] = scandum_move(pta[v2]); pta[1] = scandum_move(tmp); pta += 2;
-				x = !v3; tmp = scandum_move(pta[x]); pta[0] = scandum_move(pta[v3]); pta[1] = scandum_move(tmp); pta += 2;
-				x = !v4; tmp = scandum_move(pta[x]); pta[0] = scandum_move(pta[v4]); pta[1] = scandum_move(tmp); pta -= 6;
+	return {
+		&alloc,
+		[](const void* context, size_t bytes) -> void*
+		{
+			byte_alloc bytes_from(*static_cast<const Alloc*>(context));
 
-				quad_swap_merge<T>(pta, swap, cmp);
-			}
-			pta += 8;
+			return &*traits::allocate(bytes_from, bytes);
+		},
+		[](const void* context, void* block, size_t bytes)
+		{
+			byte_alloc bytes_from(*static_cast<const Alloc*>(context));
 
-			continue;
+			traits::deallocate(bytes_from, std::pointer_traits<typename traits::pointer>::pointer_to(*static_cast<unsigned char*>(block)), bytes);
+		}
+	};
+}
 
-		ordered:
+// scratch memory for the merge and partition routines, either on the stack,
+// allocated on construction from the caller's allocator, the thread's arena
+// or the heap, or borrowed from uninitialized storage supplied by the caller
 
-			pta += 8;
+template<typename T>
+class swap_space {
+public:
+	using value_type = T;
+	using iterator = T*;
 
-			if (count--)
+	// Uses the stack storage when it holds n elements, and allocates otherwise.
+	// Should allocating fail, all of the stack storage is used instead, as long
+	// as it holds the least number of elements the caller can get by with.
+
+	template<size_t N, typename Iterator>
+	swap_space(size_t n, size_t least, stack_swap<T, N>& stack, Iterator exemplar, const scratch_allocator* source = nullptr) : data(nullptr), count(n), constructed(0), source(source), block(nullptr), owned(false), borrowed(0)
+	{
+		if (n <= stack.capacity)
+		{
+			data = static_cast<T*>(stack.data());
+		}
+		else
+		{
+			try
 			{
-				if ((v1 = scandum_greater(cmp, *(pta + 0), *(pta + 1))) | (v2 = scandum_greater(cmp, *(pta + 2), *(pta + 3))) | (v3 = scandum_greater(cmp, *(pta + 4), *(pta + 5))) | (v4 = scandum_greater(cmp, *(pta + 6), *(pta + 7))))
-				{
-					if (v1 + v2 + v3 + v4 == 4 && scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
-					{
-						pts = pta;
-						goto reversed;
-					}
-					goto not_ordered;
-				}
-				if (scandum_not_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_not_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_not_greater(cmp, *(pta + 5), *(pta + 6)))
-				{
-					goto ordered;
-				}
-				quad_swap_merge<T>(pta, swap, cmp);
-				pta += 8;
-				continue;
+				allocate(n);
 			}
-			break;
+			catch (const std::bad_alloc&)
+			{
+				if (least > stack.capacity) throw;
 
-		reversed:
+				data = static_cast<T*>(stack.data());
+				count = stack.capacity;
+			}
+		}
+		construct(exemplar);
+	}
 
-			pta += 8;
+	template<typename Iterator>
+	swap_space(void* storage, size_t bytes, size_t limit, Iterator exemplar) : data(nullptr), count(0), constructed(0), source(nullptr), block(nullptr), owned(false), borrowed(0)
+	{
+		if (std::align(alignof(T), sizeof(T), storage, bytes))
+		{
+			data = static_cast<T*>(storage);
+			count = std::min(bytes / sizeof(T), limit);
+		}
+		construct(exemplar);
+	}
 
-			if (count--)
-			{
-				if ((v1 = scandum_not_greater(cmp, *(pta + 0), *(pta + 1))) | (v2 = scandum_not_greater(cmp, *(pta + 2), *(pta + 3))) | (v3 = scandum_not_greater(cmp, *(pta + 4), *(pta + 5))) | (v4 = scandum_not_greater(cmp, *(pta + 6), *(pta + 7))))
-				{
-					// not reversed
-				}
-				else
-				{
-					if (scandum_greater(cmp, *(pta - 1), *pta) && scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
-					{
-						goto reversed;
-					}
-				}
-				quad_reversal<T>(pts, pta - 1);
+	// a window onto n elements of another swap space, starting at offset
 
-				if (v1 + v2 + v3 + v4 == 4 && scandum_not_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_not_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_not_greater(cmp, *(pta + 5), *(pta + 6)))
-				{
-					goto ordered;
-				}
-				if (v1 + v2 + v3 + v4 == 0 && scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
-				{
-					pts = pta;
-					goto reversed;
-				}
+	swap_space(swap_space& whole, size_t offset, size_t n) : data(whole.data + offset), count(n), constructed(0), source(nullptr), block(nullptr), owned(false), borrowed(0) {}
 
-				x = !v1; tmp = scandum_move(pta[v1]); pta[0] = scandum_move(pta[x]); pta[1] = scandum_move(tmp); pta += 2;
-				x = !v2; tmp = scandum_move(pta[v2]); pta[0] = scandum_move(pta[x]); pta[1] = scandum_move(tmp); pta += 2;
-				x = !v3; tmp = scandum_move(pta[v3]); pta[0] = scandum_move(pta[x]); pta[1] = scandum_move(tmp); pta += 2;
-				x = !v4; tmp = scandum_move(pta[v4]); pta[0] = scandum_move(pta[x]); pta[1] = scandum_move(tmp); pta -= 6;
+	swap_space(const swap_space&) = delete;
+	swap_space& operator=(const swap_space&) = delete;
 
-				if (scandum_greater(cmp, *(pta + 1), *(pta + 2)) || scandum_greater(cmp, *(pta + 3), *(pta + 4)) || scandum_greater(cmp, *(pta + 5), *(pta + 6)))
-				{
-					quad_swap_merge<T>(pta, swap, cmp);
-				}
-				pta += 8;
-				continue;
-		}
+	~swap_space()
+	{
+		release();
+	}
 
-		switch (nmemb % 8)
+	constexpr iterator begin() { return data; }
+	constexpr iterator end() { return data + count; }
+	constexpr size_t size() const { return count; }
+	constexpr T& operator[](size_t i) { return data[i]; }
+
+private:
+	void allocate(size_t n)
+	{
+		size_t bytes = swap_space_bytes<T>(n);
+		void* storage = source ? source->allocate(source->context, bytes) : thread_arena.acquire(bytes);
+
+		if (storage)
 		{
-			case 7: if (scandum_not_greater(cmp, *(pta + 5), *(pta + 6))) break;
-			case 6: if (scandum_not_greater(cmp, *(pta + 4), *(pta + 5))) break;
-			case 5: if (scandum_not_greater(cmp, *(pta + 3), *(pta + 4))) break;
-			case 4: if (scandum_not_greater(cmp, *(pta + 2), *(pta + 3))) break;
-			case 3: if (scandum_not_greater(cmp, *(pta + 1), *(pta + 2))) break;
-			case 2: if (scandum_not_greater(cmp, *(pta + 0), *(pta + 1))) break;
-			case 1: if (scandum_not_greater(cmp, *(pta - 1), *(pta + 0))) break;
-			case 0:
-				quad_reversal<T>(pts, pta + nmemb % 8 - 1);
+			block = storage;
+			borrowed = bytes;
+			data = static_cast<T*>(std::align(alignof(T), n * sizeof(T), storage, bytes));
+		}
+		else
+		{
+			data = std::allocator<T>().allocate(n);
+			owned = true;
+		}
+	}
 
-				if (pts == array)
+	template<typename Iterator>
+	void construct(Iterator exemplar)
+	{
+		if constexpr (!is_raw_storage_v<T>)
+		{
+			try
+			{
+				for ( ; constructed < count ; constructed++)
 				{
-					return 1;
+					construct_scratch(data + constructed, exemplar);
 				}
-				goto reverse_end;
+			}
+			catch (...)
+			{
+				release();
+				throw;
+			}
 		}
-		quad_reversal<T>(pts, pta - 1);
-		break;
 	}
-	tail_swap<T>(pta, swap, nmemb % 8, cmp);
 
-reverse_end:
+	void release()
+	{
+		std::destroy_n(data, constructed);
 
-	pta = array;
+		if (owned) std::allocator<T>().deallocate(data, count);
 
-	for (count = nmemb / 32 ; count-- ; pta += 32)
-	{
-		if (scandum_not_greater(cmp, *(pta + 7), *(pta + 8)) && scandum_not_greater(cmp, *(pta + 15), *(pta + 16)) && scandum_not_greater(cmp, *(pta + 23), *(pta + 24)))
+		if (borrowed)
 		{
-			continue;
+			if (source) source->deallocate(source->context, block, borrowed);
+			else thread_arena.give_back(borrowed);
 		}
-		parity_merge<T>(swap.begin(), pta, 8, 8, cmp);
-		parity_merge<T>(swap.begin() + 16, pta + 16, 8, 8, cmp);
-		parity_merge<T>(pta, swap.begin(), 16, 16, cmp);
 	}
 
-	if (nmemb % 32 > 8)
-	{
-		tail_merge<T>(pta, swap, nmemb % 32, 8, cmp);
-	}
-	return 0;
-}
+	T* data;
+	size_t count;
+	size_t constructed;
+	const scratch_allocator* source;
+	void* block;
+	bool owned;
+	size_t borrowed;
+};
 
-// The next six functions are quad merge support routines
+// Comparisons may also be three-way, returning std::strong_ordering or
+// std::weak_ordering, or an int in the style of strcmp(): less than zero when
+// lhs goes before rhs. The kernels sort with them through three_way_less,
+// which tells scandum_not_greater() with one call instead of two.
 
-template<typename T, typename OutputIt, typename InputIt, typename Compare>
-void cross_merge(OutputIt dest, InputIt from, size_t left, size_t right, Compare cmp)
-{
-	size_t loop;
-#if !defined __clang__
-	size_t x, y;
+template<typename R>
+constexpr bool is_three_way_result_v =
+#if __cplusplus >= 202002L
+	std::is_same_v<R, std::strong_ordering> || std::is_same_v<R, std::weak_ordering> ||
 #endif
-	InputIt ptl = from;
-	InputIt ptr = from + left;
-	InputIt tpl = ptr - 1;
-	InputIt tpr = tpl + right;
+	std::is_same_v<R, int>;
 
-	if (left + 1 >= right && right >= left && left >= 32)
+template<typename T, typename Compare, typename = void>
+struct is_three_way_compare : std::false_type {};
+
+template<typename T, typename Compare>
+struct is_three_way_compare<T, Compare, std::void_t<std::invoke_result_t<Compare&, T&, T&>>> :
+	std::bool_constant<is_three_way_result_v<std::remove_cv_t<std::invoke_result_t<Compare&, T&, T&>>>> {};
+
+template<typename T, typename Compare>
+constexpr bool is_three_way_compare_v = is_three_way_compare<T, Compare>::value;
+
+template<typename Compare>
+struct three_way_less {
+	template<typename L, typename R>
+	bool operator()(L&& lhs, R&& rhs) const noexcept(noexcept(std::declval<Compare&>()(lhs, rhs) < 0))
 	{
-		if (scandum_greater(cmp, *(ptl + 15), *ptr) && scandum_not_greater(cmp, *ptl, *(ptr + 15)) && scandum_greater(cmp, *tpl, *(tpr - 15)) && scandum_not_greater(cmp, *(tpl - 15), *tpr))
-		{
-			parity_merge<T>(dest, from, left, right, cmp);
-			return;
-		}
+		return three(lhs, rhs) < 0;
 	}
-	OutputIt ptd = dest;
-	OutputIt tpd = dest + left + right - 1;
 
-	while (1)
+	template<typename L, typename R>
+	bool not_greater(L&& lhs, R&& rhs) const noexcept(noexcept(std::declval<Compare&>()(lhs, rhs) <= 0))
 	{
-		if (tpl - ptl > 8)
-		{
-		ptl8_ptr:
-			if (scandum_not_greater(cmp, *(ptl + 7), *ptr))
-			{
-				scandum_copy_range(T, ptd, ptl, 8); ptd += 8; ptl += 8;
-
-				if (tpl - ptl > 8) { goto ptl8_ptr; } continue;
-			}
+		return three(lhs, rhs) <= 0;
+	}
 
-		tpl8_tpr:
-			if (scandum_greater(cmp, *(tpl - 7), *tpr))
-			{
-				tpd -= 7; tpl -= 7; scandum_copy_range(T, tpd--, tpl--, 8);
+	mutable Compare three;
+};
 
-				if (tpl - ptl > 8) { goto tpl8_tpr; } continue;
-			}
-		}
+template<typename Compare>
+struct is_three_way_less : std::false_type {};
 
-		if (tpr - ptr > 8)
-		{
-		ptl_ptr8:
-			if (scandum_greater(cmp, *ptl, *(ptr + 7)))
-			{
-				scandum_copy_range(T, ptd, ptr, 8); ptd += 8; ptr += 8;
+template<typename Compare>
+struct is_three_way_less<three_way_less<Compare>> : std::true_type {};
 
-				if (tpr - ptr > 8) { goto ptl_ptr8; } continue;
-			}
+// Comparing through std::less or std::greater can't throw when the operator
+// they call can't, even though their call operators aren't noexcept
 
-		tpl_tpr8:
-			if (scandum_not_greater(cmp, *tpl, *(tpr - 7)))
-			{
-				tpd -= 7; tpr -= 7; scandum_copy_range(T, tpd--, tpr--, 8);
+template<typename T, typename Compare>
+struct is_nothrow_compare : std::bool_constant<is_three_way_compare_v<T, Compare> ? std::is_nothrow_invocable_v<Compare&, T&, T&> : std::is_nothrow_invocable_r_v<bool, Compare&, T&, T&>> {};
 
-				if (tpr - ptr > 8) { goto tpl_tpr8; } continue;
-			}
-		}
+template<typename T, typename U>
+struct is_nothrow_compare<T, std::less<U>> : std::bool_constant<noexcept(std::declval<T&>() < std::declval<T&>())> {};
 
-		if (tpd - ptd < 16)
-		{
-			break;
-		}
+template<typename T, typename U>
+struct is_nothrow_compare<T, std::greater<U>> : std::bool_constant<noexcept(std::declval<T&>() > std::declval<T&>())> {};
 
-#if !defined cmp && !defined __clang__
-		if (left > QUAD_CACHE)
-		{
-			loop = 8; do
-			{
-				*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
-				*tpd-- = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? *tpl-- : *tpr--);
-			} while (--loop);
-		}
-		else
-#endif
-		{
-			loop = 8; do
-			{
-				scandum_head_branchless_merge(ptd, x, ptl, ptr, cmp);
-				scandum_tail_branchless_merge(tpd, y, tpl, tpr, cmp);
-			} while (--loop);
-		}
-	}
+// The comparison of crumsort_prim() and quadsort_prim(), which the kernels
+// recognize to pick the thresholds the C sorts use when compiled with a cmp
+// macro: comparing primitive keys is cheap enough that quarters of the array
+// needn't be sorted apart to stay in cache, and merges stay branchless at
+// any size.
 
-	while (ptl <= tpl && ptr <= tpr)
-	{
-		*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
-	}
-	while (ptl <= tpl)
+template<typename T>
+struct prim_less {
+	constexpr bool operator()(const T& lhs, const T& rhs) const noexcept
 	{
-		*ptd++ = scandum_move(*ptl++);
+		return lhs < rhs;
 	}
-	while (ptr <= tpr)
+};
+
+template<typename T>
+struct prim_greater {
+	constexpr bool operator()(const T& lhs, const T& rhs) const noexcept
 	{
-		*ptd++ = scandum_move(*ptr++);
+		return lhs > rhs;
 	}
-}
+};
 
-template<typename T, typename Iterator, typename Compare>
-void quad_merge_block(Iterator array, swap_space<T>& swap, size_t block, Compare cmp)
-{
-	Iterator pt1, pt2, pt3;
-	size_t block_x_2 = block * 2;
+template<typename Compare>
+struct is_prim_compare : std::false_type {};
 
-	pt1 = array + block;
-	pt2 = pt1 + block;
-	pt3 = pt2 + block;
+template<typename T>
+struct is_prim_compare<prim_less<T>> : std::true_type {};
 
-	switch ((scandum_not_greater(cmp, *(pt1 - 1), *pt1)) | (scandum_not_greater(cmp, *(pt3 - 1), *pt3)) * 2)
-	{
-		case 0:
-			cross_merge<T>(swap.begin(), array, block, block, cmp);
-			cross_merge<T>(swap.begin() + block_x_2, pt2, block, block, cmp);
-			break;
-		case 1:
-			scandum_copy_range(T, swap.begin(), array, block_x_2);
-			cross_merge<T>(swap.begin() + block_x_2, pt2, block, block, cmp);
-			break;
-		case 2:
-			cross_merge<T>(swap.begin(), array, block, block, cmp);
-			scandum_copy_range(T, swap.begin() + block_x_2, pt2, block_x_2);
-			break;
-		case 3:
-			if (scandum_not_greater(cmp, *(pt2 - 1), *pt2))
-				return;
-			scandum_copy_range(T, swap.begin(), array, block_x_2 * 2);
-	}
-	cross_merge<T>(array, swap.begin(), block_x_2, block_x_2, cmp);
-}
+template<typename T>
+struct is_prim_compare<prim_greater<T>> : std::true_type {};
 
-template<typename T, typename Iterator, typename Compare>
-size_t quad_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
-{
-	Iterator pta, pte;
+template<typename Compare>
+constexpr bool is_prim_compare_v = is_prim_compare<std::remove_cv_t<std::remove_reference_t<Compare>>>::value;
 
-	pte = array + nmemb;
+// std::less and std::greater on arithmetic types, typed or transparent, are
+// sorted with prim_less and prim_greater, which compare the same way
 
-	block *= 4;
+template<typename T, typename Compare, bool = std::is_arithmetic_v<T>>
+struct known_compare {
+	using type = Compare;
+};
 
-	while (block <= nmemb && block <= swap.size())
-	{
-		pta = array;
+template<typename T>
+struct known_compare<T, std::less<T>, true> {
+	using type = prim_less<T>;
+};
 
-		do
-		{
-			quad_merge_block<T>(pta, swap, block / 4, cmp);
+template<typename T>
+struct known_compare<T, std::less<>, true> {
+	using type = prim_less<T>;
+};
 
-			pta += block;
-		} while (pta + block <= pte);
+template<typename T>
+struct known_compare<T, std::greater<T>, true> {
+	using type = prim_greater<T>;
+};
 
-		tail_merge<T>(pta, swap, pte - pta, block / 4, cmp);
+template<typename T>
+struct known_compare<T, std::greater<>, true> {
+	using type = prim_greater<T>;
+};
 
-		block *= 4;
-	}
+template<typename T, typename Compare>
+using known_compare_t = typename known_compare<T, Compare>::type;
 
-	tail_merge<T>(array, swap, nmemb, block / 4, cmp);
+// whether an iterator can be swapped for a pointer to the element it refers
+// to, which C++17 can only tell for pointers and the iterators of vectors
 
-	return block / 2;
-}
+#if __cplusplus >= 202002L
+template<typename Iterator>
+constexpr bool is_contiguous_iterator_v = std::contiguous_iterator<Iterator>;
+#else
+template<typename Iterator, typename T = typename std::iterator_traits<Iterator>::value_type, bool = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>
+constexpr bool is_contiguous_iterator_v = std::is_pointer_v<Iterator>;
 
-template<typename T, typename Iterator, typename Compare>
-void partial_forward_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
+template<typename Iterator, typename T>
+constexpr bool is_contiguous_iterator_v<Iterator, T, true> = std::is_pointer_v<Iterator> || std::is_same_v<Iterator, typename std::vector<T>::iterator>;
+#endif
+
+// Calls sort(array, cmp), with a three-way comparison wrapped in
+// three_way_less, a known comparison swapped for its primitive counterpart
+// and, for primitive comparisons, a contiguous iterator swapped for a pointer
+
+template<typename T, typename Iterator, typename Compare, typename Sort>
+void with_known_compare(Iterator array, size_t nmemb, Compare cmp, Sort sort)
 {
-	typename swap_space<T>::iterator ptl, tpl;
-	Iterator ptr, tpr;
-	size_t x;
+	typedef known_compare_t<std::remove_cv_t<T>, Compare> Known;
 
-	if (nmemb == block)
+	if constexpr (is_three_way_compare_v<T, Compare>)
 	{
-		return;
+		sort(array, three_way_less<Compare> { cmp });
 	}
+	else if constexpr (!is_prim_compare_v<Known>)
+	{
+		sort(array, cmp);
+	}
+	else if constexpr (is_contiguous_iterator_v<Iterator>)
+	{
+		sort(nmemb ? std::addressof(*array) : static_cast<T*>(nullptr), Known());
+	}
+	else
+	{
+		sort(array, Known());
+	}
+}
 
-	ptr = array + block;
-	tpr = array + nmemb - 1;
+// scandum_not_greater(), which for a strict weak ordering takes one call,
+// but calls the comparison twice unless it is known to be one, or is
+// three-way
 
-	if (scandum_not_greater(cmp, *(ptr - 1), *ptr))
+template<typename Compare, typename L, typename R>
+bool not_greater(Compare&& cmp, L&& lhs, R&& rhs)
+{
+	if constexpr (is_prim_compare_v<Compare>)
 	{
-		return;
+		return !cmp(rhs, lhs);
+	}
+	else if constexpr (is_three_way_less<std::remove_cv_t<std::remove_reference_t<Compare>>>::value)
+	{
+		return cmp.not_greater(lhs, rhs);
+	}
+	else
+	{
+		return cmp(lhs, rhs) || !cmp(rhs, lhs);
 	}
+}
 
-	scandum_copy_range(T, swap.begin(), array, block);
+// orders a pair of primitive keys, telling whether they were out of order
 
-	ptl = swap.begin();
-	tpl = swap.begin() + block - 1;
+template<typename Iterator, typename Compare>
+bool prim_swap(Iterator pta, Compare cmp)
+{
+	auto lhs = pta[0], rhs = pta[1];
+	bool x = cmp(rhs, lhs);
 
-	while (ptl < tpl - 1 && ptr < tpr - 1)
-	{
-	ptr2:
-		if (scandum_greater(cmp, *ptl, *(ptr + 1)))
-		{
-			*array++ = scandum_move(*ptr++); *array++ = scandum_move(*ptr++);
+	pta[0] = x ? rhs : lhs;
+	pta[1] = x ? lhs : rhs;
 
-			if (ptr < tpr - 1) { goto ptr2; } break;
-		}
-		if (scandum_not_greater(cmp, *(ptl + 1), *ptr))
-		{
-			*array++ = scandum_move(*ptl++); *array++ = scandum_move(*ptl++);
+	return x;
+}
 
-			if (ptl < tpl - 1) { goto ptl2; } break;
-		}
+#ifdef SCANDUM_SIMD
 
-		goto cross_swap;
+// the widest vectors the processor and operating system support, detected
+// once, and those the sorts use, no wider than set_simd_isa() allows
 
-	ptl2:
-		if (scandum_not_greater(cmp, *(ptl + 1), *ptr))
-		{
-			*array++ = scandum_move(*ptl++); *array++ = scandum_move(*ptl++);
+inline std::atomic<simd_isa> simd_isa_limit { simd_isa::avx512 };
 
-			if (ptl < tpl - 1) { goto ptl2; } break;
-		}
+inline simd_isa detect_simd_isa() noexcept
+{
+#if defined _MSC_VER && !defined __clang__
+	int info[4];
 
-		if (scandum_greater(cmp, *ptl, *(ptr + 1)))
-		{
-			*array++ = scandum_move(*ptr++); *array++ = scandum_move(*ptr++);
+	__cpuid(info, 0);
 
-			if (ptr < tpr - 1) { goto ptr2; } break;
-		}
+	if (info[0] < 7)
+	{
+		return simd_isa::scalar;
+	}
+	__cpuid(info, 1);
 
-	cross_swap:
+	// popcnt, osxsave and avx
 
-		x = scandum_not_greater(cmp, *ptl, *ptr);
-		array[x] = scandum_move(*ptr);
-		ptr += 1;
-		array[!x] = scandum_move(*ptl);
-		ptl += 1;
-		array += 2;
-		scandum_head_branchless_merge(array, x, ptl, ptr, cmp);
+	if ((info[2] & 0x18800000) != 0x18800000)
+	{
+		return simd_isa::scalar;
 	}
+	unsigned long long xcr0 = _xgetbv(0);
 
-	while (ptl <= tpl && ptr <= tpr)
+	__cpuidex(info, 7, 0);
+
+	bool avx2 = (xcr0 & 0x06) == 0x06 && (info[1] & 0x20);
+
+	if (avx2 && (xcr0 & 0xe6) == 0xe6 && (info[1] & 0x10000))
 	{
-		*array++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? (T&)*ptl++ : (T&)*ptr++);
+		return simd_isa::avx512;
 	}
+	return avx2 ? simd_isa::avx2 : simd_isa::scalar;
+#else
+	__builtin_cpu_init();
 
-	while (ptl <= tpl)
+	if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("popcnt"))
 	{
-		*array++ = scandum_move(*ptl++);
+		return simd_isa::scalar;
 	}
+	return __builtin_cpu_supports("avx512f") ? simd_isa::avx512 : simd_isa::avx2;
+#endif
 }
 
-template<typename T, typename Iterator, typename Compare>
-void partial_backward_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
+inline simd_isa cpu_simd_isa() noexcept
 {
-	Iterator tpl, tpa;
-	typename swap_space<T>::iterator tpr;
-	size_t right, loop, x;
+	static const simd_isa isa = detect_simd_isa();
+	simd_isa limit = simd_isa_limit.load(std::memory_order_relaxed);
 
-	if (nmemb == block)
-	{
-		return;
-	}
+	return limit < isa ? limit : isa;
+}
 
-	tpl = array + block - 1;
-	tpa = array + nmemb - 1;
+// whether an array is sorted with the vector kernels: 32 and 64 bit integers
+// and floating point numbers behind a pointer, compared with prim_less or
+// prim_greater
 
-	if (scandum_not_greater(cmp, *tpl, *(tpl + 1)))
-	{
-		return;
-	}
+template<typename T, typename Iterator, typename Compare>
+constexpr bool is_simd_key_v =
+	std::is_same_v<Iterator, T*> &&
+	(std::is_same_v<Compare, prim_less<T>> || std::is_same_v<Compare, prim_greater<T>>) &&
+	(std::is_integral_v<T> || std::is_floating_point_v<T>) &&
+	!std::is_same_v<T, bool> && (sizeof(T) == 4 || sizeof(T) == 8);
 
-	right = nmemb - block;
+// whether they are sorted with the sorting networks, which aren't stable:
+// integers only, as the networks would reorder 0.0 and -0.0
+
+template<typename T, typename Iterator, typename Compare>
+constexpr bool is_simd_network_v = is_simd_key_v<T, Iterator, Compare> && std::is_integral_v<T>;
+
+// Vectors of keys. Unsigned keys are compared as signed ones with the sign
+// bit flipped, as AVX2 only compares signed integers. Floating point numbers
+// compare as the scalar operators do, false for NaN.
+
+template<typename T>
+SCANDUM_TARGET_AVX2 inline __m256i avx2_set1(T key)
+{
+	if constexpr (std::is_same_v<T, float>)
+	{
+		return _mm256_castps_si256(_mm256_set1_ps(key));
+	}
+	else if constexpr (std::is_floating_point_v<T>)
+	{
+		return _mm256_castpd_si256(_mm256_set1_pd(key));
+	}
+	else if constexpr (sizeof(T) == 4)
+	{
+		return _mm256_set1_epi32(static_cast<int>(key));
+	}
+	else
+	{
+		return _mm256_set1_epi64x(static_cast<long long>(key));
+	}
+}
+
+// lanes where lhs < rhs, all bits set
+
+template<typename T>
+SCANDUM_TARGET_AVX2 inline __m256i avx2_less(__m256i lhs, __m256i rhs)
+{
+	if constexpr (std::is_same_v<T, float>)
+	{
+		return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(lhs), _mm256_castsi256_ps(rhs), _CMP_LT_OQ));
+	}
+	else if constexpr (std::is_floating_point_v<T>)
+	{
+		return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(lhs), _mm256_castsi256_pd(rhs), _CMP_LT_OQ));
+	}
+	else if constexpr (std::is_unsigned_v<T>)
+	{
+		__m256i sign = avx2_set1<std::make_signed_t<T>>(std::numeric_limits<std::make_signed_t<T>>::min());
+
+		return avx2_less<std::make_signed_t<T>>(_mm256_xor_si256(lhs, sign), _mm256_xor_si256(rhs, sign));
+	}
+	else if constexpr (sizeof(T) == 4)
+	{
+		return _mm256_cmpgt_epi32(rhs, lhs);
+	}
+	else
+	{
+		return _mm256_cmpgt_epi64(rhs, lhs);
+	}
+}
+
+// a bit per lane where cmp(lhs, rhs)
+
+template<typename T, typename Compare>
+SCANDUM_TARGET_AVX2 inline unsigned avx2_compare(__m256i lhs, __m256i rhs)
+{
+	__m256i less = std::is_same_v<Compare, prim_less<T>> ? avx2_less<T>(lhs, rhs) : avx2_less<T>(rhs, lhs);
+
+	if constexpr (sizeof(T) == 4)
+	{
+		return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+	}
+	else
+	{
+		return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+	}
+}
+
+template<typename T>
+SCANDUM_TARGET_AVX512 inline __m512i avx512_set1(T key)
+{
+	if constexpr (std::is_same_v<T, float>)
+	{
+		return _mm512_castps_si512(_mm512_set1_ps(key));
+	}
+	else if constexpr (std::is_floating_point_v<T>)
+	{
+		return _mm512_castpd_si512(_mm512_set1_pd(key));
+	}
+	else if constexpr (sizeof(T) == 4)
+	{
+		return _mm512_set1_epi32(static_cast<int>(key));
+	}
+	else
+	{
+		return _mm512_set1_epi64(static_cast<long long>(key));
+	}
+}
+
+// a bit per lane where lhs < rhs
+
+template<typename T>
+SCANDUM_TARGET_AVX512 inline unsigned avx512_less(__m512i lhs, __m512i rhs)
+{
+	if constexpr (std::is_same_v<T, float>)
+	{
+		return _mm512_cmp_ps_mask(_mm512_castsi512_ps(lhs), _mm512_castsi512_ps(rhs), _CMP_LT_OQ);
+	}
+	else if constexpr (std::is_floating_point_v<T>)
+	{
+		return _mm512_cmp_pd_mask(_mm512_castsi512_pd(lhs), _mm512_castsi512_pd(rhs), _CMP_LT_OQ);
+	}
+	else if constexpr (sizeof(T) == 4)
+	{
+		return std::is_signed_v<T> ? _mm512_cmplt_epi32_mask(lhs, rhs) : _mm512_cmplt_epu32_mask(lhs, rhs);
+	}
+	else
+	{
+		return std::is_signed_v<T> ? _mm512_cmplt_epi64_mask(lhs, rhs) : _mm512_cmplt_epu64_mask(lhs, rhs);
+	}
+}
+
+// a bit per lane where cmp(lhs, rhs)
+
+template<typename T, typename Compare>
+SCANDUM_TARGET_AVX512 inline unsigned avx512_compare(__m512i lhs, __m512i rhs)
+{
+	return std::is_same_v<Compare, prim_less<T>> ? avx512_less<T>(lhs, rhs) : avx512_less<T>(rhs, lhs);
+}
+
+// Finishes a merge of strides of keys, going forward or backward: the Stride
+// keys still pending, in order at keys, are merged with the rest of the run
+// that has less than a stride left, and the result with the rest of the other
+// run
+
+template<typename T, typename Compare, bool Backward, size_t Stride>
+void merge_strides_tail(T* ptd, const T* keys, const T* ptl, size_t left, const T* ptr, size_t right)
+{
+	constexpr std::ptrdiff_t step = Backward ? -1 : 1;
+	Compare cmp;
+	T merged[Stride * 2];
+	T* ptm = merged;
+	size_t pending = Stride, x;
+
+	if (left >= Stride)
+	{
+		std::swap(ptl, ptr);
+		std::swap(left, right);
+	}
+
+	while (pending && left)
+	{
+		x = cmp(*ptl, *keys);
+		*ptm++ = x ? *ptl : *keys;
+		ptl += step * static_cast<std::ptrdiff_t>(x); left -= x;
+		keys += !x; pending -= !x;
+	}
+	while (pending--)
+	{
+		*ptm++ = *keys++;
+	}
+	while (left--)
+	{
+		*ptm++ = *ptl;
+		ptl += step;
+	}
+
+	size_t rest = ptm - merged;
+
+	ptm = merged;
+
+	while (rest && right)
+	{
+		x = cmp(*ptr, *ptm);
+		*ptd = x ? *ptr : *ptm;
+		ptd += step;
+		ptr += step * static_cast<std::ptrdiff_t>(x); right -= x;
+		ptm += !x; rest -= !x;
+	}
+	while (rest--)
+	{
+		*ptd = *ptm++;
+		ptd += step;
+	}
+	while (right--)
+	{
+		*ptd = *ptr;
+		ptd += step;
+		ptr += step;
+	}
+}
+
+// a vector of f(0) to f(7) in its 32 bit lanes
+
+template<typename F>
+SCANDUM_TARGET_AVX2 inline __m256i avx2_lanes(F f)
+{
+	return _mm256_setr_epi32(f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7));
+}
+
+// Sorting networks for up to 32 integer keys in AVX2 registers, which AVX-512
+// processors run as well. The keys are mapped to signed integers that order as
+// the comparison does, and sorted with bitonic networks: each register on its
+// own, and then runs of registers merged in pairs.
+
+template<typename T, typename Compare>
+struct avx2_network {
+	static constexpr size_t lanes = 32 / sizeof(T);
+	static constexpr int span = static_cast<int>(8 / lanes); // 32 bit lanes per key
+	static constexpr size_t stride = lanes * 4; // keys per step of a merge
+
+	typedef std::conditional_t<std::is_same_v<Compare, prim_less<T>>, prim_greater<T>, prim_less<T>> opposite;
+
+	// signed integers order as unsigned ones with the sign bit flipped
+
+	SCANDUM_INLINE_AVX2 static __m256i flip(__m256i vec)
+	{
+		if constexpr (std::is_unsigned_v<T>)
+		{
+			return _mm256_xor_si256(vec, avx2_lanes([](int i) { return i % span == span - 1 ? std::numeric_limits<int>::min() : 0; }));
+		}
+		return vec;
+	}
+
+	// and in the opposite order with all bits flipped
+
+	SCANDUM_INLINE_AVX2 static __m256i invert(__m256i vec)
+	{
+		return std::is_same_v<Compare, prim_greater<T>> ? _mm256_xor_si256(vec, _mm256_set1_epi32(-1)) : vec;
+	}
+
+	SCANDUM_INLINE_AVX2 static __m256i order(__m256i vec)
+	{
+		return invert(flip(vec));
+	}
+
+	SCANDUM_INLINE_AVX2 static __m256i unorder(__m256i vec)
+	{
+		return flip(invert(vec));
+	}
+
+	SCANDUM_INLINE_AVX2 static __m256i greater(__m256i lhs, __m256i rhs)
+	{
+		return sizeof(T) == 4 ? _mm256_cmpgt_epi32(lhs, rhs) : _mm256_cmpgt_epi64(lhs, rhs);
+	}
+
+	// lhs and rhs become the lesser and greater of each pair of lanes, with
+	// a minimum and maximum where AVX2 has them
+
+	SCANDUM_INLINE_AVX2 static void exchange(__m256i& lhs, __m256i& rhs)
+	{
+		if constexpr (sizeof(T) == 4)
+		{
+			__m256i tmp = lhs;
+
+			lhs = _mm256_min_epi32(lhs, rhs);
+			rhs = _mm256_max_epi32(tmp, rhs);
+		}
+		else
+		{
+			__m256i gt = greater(lhs, rhs), tmp = lhs;
+
+			lhs = _mm256_blendv_epi8(lhs, rhs, gt);
+			rhs = _mm256_blendv_epi8(rhs, tmp, gt);
+		}
+	}
+
+	// whether the key in lane i keeps the greater of its pair in step<K, J>,
+	// and a bit per 32 bit lane that does
+
+	static constexpr bool keeps_greater(int i, int K, int J)
+	{
+		return ((i / span & J) == 0) != ((i / span & K) == 0);
+	}
+
+	static constexpr int keeps_greater(int K, int J)
+	{
+		int mask = 0;
+
+		for (int i = 0 ; i < 8 ; i++)
+		{
+			mask |= keeps_greater(i, K, J) << i;
+		}
+		return mask;
+	}
+
+	// orders each key lane with the lane J further or back, keeping the
+	// lesser in the lower lane where the lane has bit K clear
+
+	template<int K, int J>
+	SCANDUM_INLINE_AVX2 static __m256i step(__m256i vec)
+	{
+		__m256i pair = _mm256_permutevar8x32_epi32(vec, avx2_lanes([](int i) { return (i / span ^ J) * span + i % span; }));
+
+		if constexpr (sizeof(T) == 4)
+		{
+			return _mm256_blend_epi32(_mm256_min_epi32(vec, pair), _mm256_max_epi32(vec, pair), keeps_greater(K, J));
+		}
+		else
+		{
+			__m256i high = avx2_lanes([](int i) { return -static_cast<int>(keeps_greater(i, K, J)); });
+
+			return _mm256_blendv_epi8(vec, pair, _mm256_xor_si256(greater(vec, pair), high));
+		}
+	}
+
+	SCANDUM_INLINE_AVX2 static __m256i reverse(__m256i vec)
+	{
+		return _mm256_permutevar8x32_epi32(vec, avx2_lanes([](int i) { return (8 / span - 1 - i / span) * span + i % span; }));
+	}
+
+	SCANDUM_INLINE_AVX2 static __m256i sort(__m256i vec)
+	{
+		vec = step<2, 1>(vec);
+		vec = step<4, 2>(vec);
+		vec = step<4, 1>(vec);
+
+		if constexpr (lanes == 8)
+		{
+			vec = step<8, 4>(vec);
+			vec = step<8, 2>(vec);
+			vec = step<8, 1>(vec);
+		}
+		return vec;
+	}
+
+	// sorts a register holding a bitonic sequence
+
+	SCANDUM_INLINE_AVX2 static __m256i clean(__m256i vec)
+	{
+		if constexpr (lanes == 8)
+		{
+			vec = step<8, 4>(vec);
+		}
+		vec = step<lanes, 2>(vec);
+		vec = step<lanes, 1>(vec);
+
+		return vec;
+	}
+
+	// The next three are unrolled at compile time, so that the keys stay in
+	// registers rather than on the stack. bitonic() reverses the second half of R registers,
+	// exchange() orders each register in the lower half of every group of
+	// Dist * 2 with the one Dist further, and clean() sorts each register
+	// holding a bitonic sequence.
+
+	template<size_t R, size_t Cnt = R / 2>
+	SCANDUM_INLINE_AVX2 static void bitonic(__m256i* regs)
+	{
+		if constexpr (Cnt <= R * 3 / 2 - 1 - Cnt)
+		{
+			__m256i tmp = reverse(regs[Cnt]);
+
+			regs[Cnt] = reverse(regs[R * 3 / 2 - 1 - Cnt]);
+			regs[R * 3 / 2 - 1 - Cnt] = tmp;
+
+			bitonic<R, Cnt + 1>(regs);
+		}
+	}
+
+	template<size_t R, size_t Dist, size_t Cnt = 0>
+	SCANDUM_INLINE_AVX2 static void exchange(__m256i* regs)
+	{
+		if constexpr (Dist && Cnt < R)
+		{
+			if constexpr ((Cnt & Dist) == 0)
+			{
+				exchange(regs[Cnt], regs[Cnt + Dist]);
+			}
+			exchange<R, Dist, Cnt + 1>(regs);
+		}
+		else if constexpr (Dist)
+		{
+			exchange<R, Dist / 2>(regs);
+		}
+	}
+
+	template<size_t R, size_t Cnt = 0>
+	SCANDUM_INLINE_AVX2 static void clean(__m256i* regs)
+	{
+		if constexpr (Cnt < R)
+		{
+			regs[Cnt] = clean(regs[Cnt]);
+
+			clean<R, Cnt + 1>(regs);
+		}
+	}
+
+	// merges the sorted halves of R registers, merging the first half with
+	// the reversed second half, which makes a bitonic sequence
+
+	template<size_t R>
+	SCANDUM_INLINE_AVX2 static void merge(__m256i* regs)
+	{
+		bitonic<R>(regs);
+		exchange<R, R / 2>(regs);
+		clean<R>(regs);
+	}
+
+	// merges the sorted runs of Run registers in R registers
+
+	template<size_t R, size_t Run, size_t Cnt = 0>
+	SCANDUM_INLINE_AVX2 static void merge_runs(__m256i* regs)
+	{
+		if constexpr (Run < R && Cnt < R)
+		{
+			merge<Run * 2>(regs + Cnt);
+			merge_runs<R, Run, Cnt + Run * 2>(regs);
+		}
+		else if constexpr (Run < R)
+		{
+			merge_runs<R, Run * 2>(regs);
+		}
+	}
+
+	// R registers of keys at array, or before it going backward, in the order
+	// of the sort
+
+	template<size_t R, bool Backward = false, size_t Cnt = 0>
+	SCANDUM_INLINE_AVX2 static void load(const T* array, __m256i* regs)
+	{
+		if constexpr (Cnt < R && Backward)
+		{
+			regs[Cnt] = reverse(order(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(array - lanes * (Cnt + 1) + 1))));
+
+			load<R, Backward, Cnt + 1>(array, regs);
+		}
+		else if constexpr (Cnt < R)
+		{
+			regs[Cnt] = order(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(array + lanes * Cnt)));
+
+			load<R, Backward, Cnt + 1>(array, regs);
+		}
+	}
+
+	template<size_t R, bool Backward = false, size_t Cnt = 0>
+	SCANDUM_INLINE_AVX2 static void store(T* array, const __m256i* regs)
+	{
+		if constexpr (Cnt < R && Backward)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(array - lanes * (Cnt + 1) + 1), unorder(reverse(regs[Cnt])));
+
+			store<R, Backward, Cnt + 1>(array, regs);
+		}
+		else if constexpr (Cnt < R)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(array + lanes * Cnt), unorder(regs[Cnt]));
+
+			store<R, Backward, Cnt + 1>(array, regs);
+		}
+	}
+
+	// sorts R registers of keys, padding the last with the greatest key
+
+	template<size_t R>
+	SCANDUM_TARGET_AVX2 static void sort(T* array, size_t nmemb)
+	{
+		__m256i regs[R];
+		__m256i most = avx2_lanes([](int i) { return i % span == span - 1 ? std::numeric_limits<int>::max() : -1; });
+		__m256i index = avx2_lanes([](int i) { return i; });
+		size_t cnt;
+
+		for (cnt = 0 ; cnt < R ; cnt++)
+		{
+			if (nmemb >= (cnt + 1) * lanes)
+			{
+				regs[cnt] = order(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(array + cnt * lanes)));
+			}
+			else if (nmemb > cnt * lanes)
+			{
+				__m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(nmemb - cnt * lanes) * span), index);
+
+				regs[cnt] = _mm256_blendv_epi8(most, order(_mm256_maskload_epi32(reinterpret_cast<const int*>(array + cnt * lanes), mask)), mask);
+			}
+			else
+			{
+				regs[cnt] = most;
+			}
+			regs[cnt] = sort(regs[cnt]);
+		}
+		merge_runs<R, 1>(regs);
+
+		for (cnt = 0 ; cnt < R ; cnt++)
+		{
+			if (nmemb >= (cnt + 1) * lanes)
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(array + cnt * lanes), unorder(regs[cnt]));
+			}
+			else if (nmemb > cnt * lanes)
+			{
+				__m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(nmemb - cnt * lanes) * span), index);
+
+				_mm256_maskstore_epi32(reinterpret_cast<int*>(array + cnt * lanes), mask, unorder(regs[cnt]));
+			}
+		}
+	}
+
+	// sorts up to 32 keys
+
+	SCANDUM_TARGET_AVX2 static void sort(T* array, size_t nmemb)
+	{
+		if (nmemb <= lanes)
+		{
+			sort<1>(array, nmemb);
+		}
+		else if (nmemb <= lanes * 2)
+		{
+			sort<2>(array, nmemb);
+		}
+		else if (nmemb <= lanes * 4)
+		{
+			sort<4>(array, nmemb);
+		}
+		else
+		{
+			sort<32 / lanes>(array, nmemb);
+		}
+	}
+
+	// merges four sorted runs of 8 keys
+
+	SCANDUM_TARGET_AVX2 static void merge32(T* array)
+	{
+		constexpr size_t R = 32 / lanes;
+		__m256i regs[R];
+
+		load<R>(array, regs);
+		merge_runs<R, R / 4>(regs);
+		store<R>(array, regs);
+	}
+
+	// Merges runs of left and right keys, of at least stride keys each, a
+	// stride at a time: the keys that are pending and the next stride of the
+	// run with the lesser head are merged with a bitonic network, the lesser
+	// half is written out, and the greater half is pending. Going backward,
+	// the runs are merged from their last keys in the opposite order. The
+	// output may overlap the runs as it may for the scalar merges.
+
+	template<bool Backward>
+	SCANDUM_TARGET_AVX2 static void merge_strides(T* ptd, const T* ptl, size_t left, const T* ptr, size_t right)
+	{
+		constexpr std::ptrdiff_t step = Backward ? -1 : 1;
+		constexpr size_t R = stride / lanes;
+		Compare cmp;
+		__m256i regs[R * 2];
+		size_t x;
+
+		load<R, Backward>(ptl, regs);
+		load<R, Backward>(ptr, regs + R);
+
+		ptl += step * stride; left -= stride;
+		ptr += step * stride; right -= stride;
+
+		while (1)
+		{
+			merge<R * 2>(regs);
+
+			store<R, Backward>(ptd, regs);
+
+			ptd += step * stride;
+
+			if (left < stride || right < stride)
+			{
+				break;
+			}
+			x = cmp(*ptr, *ptl);
+
+			load<R, Backward>(x ? ptr : ptl, regs);
+
+			ptr += step * static_cast<std::ptrdiff_t>(x * stride); right -= x * stride;
+			ptl += step * static_cast<std::ptrdiff_t>(!x * stride); left -= !x * stride;
+		}
+
+		T keys[stride];
+
+		store<R>(keys, regs + R);
+
+		merge_strides_tail<T, Compare, Backward, stride>(ptd, keys, ptl, left, ptr, right);
+	}
+
+	// merges runs of at least stride keys into array
+
+	SCANDUM_TARGET_AVX2 static void forward_merge(T* array, const T* ptl, size_t left, const T* ptr, size_t right)
+	{
+		merge_strides<false>(array, ptl, left, ptr, right);
+	}
+
+	// merges runs of at least stride keys into array, from their ends and
+	// those of array
+
+	SCANDUM_TARGET_AVX2 static void backward_merge(T* array, const T* ptl, size_t left, const T* ptr, size_t right)
+	{
+		avx2_network<T, opposite>::template merge_strides<true>(array + left + right - 1, ptl + left - 1, left, ptr + right - 1, right);
+	}
+};
+
+// a vector of f(0) to f(15) in its 32 bit lanes
+
+template<typename F>
+SCANDUM_TARGET_AVX512 inline __m512i avx512_lanes(F f)
+{
+	return _mm512_setr_epi32(f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7), f(8), f(9), f(10), f(11), f(12), f(13), f(14), f(15));
+}
+
+// The merges of avx2_network in AVX-512 registers, which have twice the lanes
+// and a minimum and maximum of 64 bit integers as well
+
+template<typename T, typename Compare>
+struct avx512_network {
+	static constexpr size_t lanes = 64 / sizeof(T);
+	static constexpr int span = static_cast<int>(16 / lanes); // 32 bit lanes per key
+	static constexpr size_t stride = lanes * 2; // keys per step of a merge
+
+	typedef std::conditional_t<std::is_same_v<Compare, prim_less<T>>, prim_greater<T>, prim_less<T>> opposite;
+
+	// keys in the opposite order with all bits flipped
+
+	SCANDUM_INLINE_AVX512 static __m512i order(__m512i vec)
+	{
+		return std::is_same_v<Compare, prim_greater<T>> ? _mm512_xor_si512(vec, _mm512_set1_epi32(-1)) : vec;
+	}
+
+	// the forms with a mask of all lanes, as GCC warns of the undefined vector
+	// the others merge into
+
+	SCANDUM_INLINE_AVX512 static __m512i min(__m512i lhs, __m512i rhs)
+	{
+		if constexpr (sizeof(T) == 4)
+		{
+			return std::is_signed_v<T> ? _mm512_maskz_min_epi32(0xffff, lhs, rhs) : _mm512_maskz_min_epu32(0xffff, lhs, rhs);
+		}
+		else
+		{
+			return std::is_signed_v<T> ? _mm512_maskz_min_epi64(0xff, lhs, rhs) : _mm512_maskz_min_epu64(0xff, lhs, rhs);
+		}
+	}
+
+	SCANDUM_INLINE_AVX512 static __m512i max(__m512i lhs, __m512i rhs)
+	{
+		if constexpr (sizeof(T) == 4)
+		{
+			return std::is_signed_v<T> ? _mm512_maskz_max_epi32(0xffff, lhs, rhs) : _mm512_maskz_max_epu32(0xffff, lhs, rhs);
+		}
+		else
+		{
+			return std::is_signed_v<T> ? _mm512_maskz_max_epi64(0xff, lhs, rhs) : _mm512_maskz_max_epu64(0xff, lhs, rhs);
+		}
+	}
+
+	SCANDUM_INLINE_AVX512 static void exchange(__m512i& lhs, __m512i& rhs)
+	{
+		__m512i tmp = lhs;
+
+		lhs = min(lhs, rhs);
+		rhs = max(tmp, rhs);
+	}
+
+	// the lanes of the keys with bit J set
+
+	static constexpr __mmask16 upper(int J)
+	{
+		__mmask16 mask = 0;
+
+		for (int i = 0 ; i < 16 ; i++)
+		{
+			mask |= static_cast<__mmask16>((i / span & J) != 0) << i;
+		}
+		return mask;
+	}
+
+	// orders each key lane with the lane J further or back, keeping the
+	// lesser in the lower lane
+
+	template<int J>
+	SCANDUM_INLINE_AVX512 static __m512i step(__m512i vec)
+	{
+		__m512i pair = _mm512_maskz_permutexvar_epi32(0xffff, avx512_lanes([](int i) { return (i / span ^ J) * span + i % span; }), vec);
+
+		return _mm512_mask_blend_epi32(upper(J), min(vec, pair), max(vec, pair));
+	}
+
+	SCANDUM_INLINE_AVX512 static __m512i reverse(__m512i vec)
+	{
+		return _mm512_maskz_permutexvar_epi32(0xffff, avx512_lanes([](int i) { return (16 / span - 1 - i / span) * span + i % span; }), vec);
+	}
+
+	// sorts a register holding a bitonic sequence
+
+	template<int J = lanes / 2>
+	SCANDUM_INLINE_AVX512 static __m512i clean(__m512i vec)
+	{
+		if constexpr (J)
+		{
+			return clean<J / 2>(step<J>(vec));
+		}
+		return vec;
+	}
+
+	// merges two sorted pairs of registers
+
+	SCANDUM_INLINE_AVX512 static void merge(__m512i* regs)
+	{
+		__m512i tmp = reverse(regs[2]);
+
+		regs[2] = reverse(regs[3]);
+		regs[3] = tmp;
+
+		exchange(regs[0], regs[2]);
+		exchange(regs[1], regs[3]);
+		exchange(regs[0], regs[1]);
+		exchange(regs[2], regs[3]);
+
+		regs[0] = clean(regs[0]);
+		regs[1] = clean(regs[1]);
+		regs[2] = clean(regs[2]);
+		regs[3] = clean(regs[3]);
+	}
+
+	template<bool Backward>
+	SCANDUM_INLINE_AVX512 static void load(const T* array, __m512i* regs)
+	{
+		if constexpr (Backward)
+		{
+			regs[0] = reverse(order(_mm512_loadu_si512(array - lanes + 1)));
+			regs[1] = reverse(order(_mm512_loadu_si512(array - lanes * 2 + 1)));
+		}
+		else
+		{
+			regs[0] = order(_mm512_loadu_si512(array));
+			regs[1] = order(_mm512_loadu_si512(array + lanes));
+		}
+	}
+
+	template<bool Backward>
+	SCANDUM_INLINE_AVX512 static void store(T* array, const __m512i* regs)
+	{
+		if constexpr (Backward)
+		{
+			_mm512_storeu_si512(array - lanes + 1, order(reverse(regs[0])));
+			_mm512_storeu_si512(array - lanes * 2 + 1, order(reverse(regs[1])));
+		}
+		else
+		{
+			_mm512_storeu_si512(array, order(regs[0]));
+			_mm512_storeu_si512(array + lanes, order(regs[1]));
+		}
+	}
+
+	// avx2_network::merge_strides() with two registers per stride
+
+	template<bool Backward>
+	SCANDUM_TARGET_AVX512 static void merge_strides(T* ptd, const T* ptl, size_t left, const T* ptr, size_t right)
+	{
+		constexpr std::ptrdiff_t step = Backward ? -1 : 1;
+		Compare cmp;
+		__m512i regs[4];
+		size_t x;
+
+		load<Backward>(ptl, regs);
+		load<Backward>(ptr, regs + 2);
+
+		ptl += step * stride; left -= stride;
+		ptr += step * stride; right -= stride;
+
+		while (1)
+		{
+			merge(regs);
+
+			store<Backward>(ptd, regs);
+
+			ptd += step * stride;
+
+			if (left < stride || right < stride)
+			{
+				break;
+			}
+			x = cmp(*ptr, *ptl);
+
+			load<Backward>(x ? ptr : ptl, regs);
+
+			ptr += step * static_cast<std::ptrdiff_t>(x * stride); right -= x * stride;
+			ptl += step * static_cast<std::ptrdiff_t>(!x * stride); left -= !x * stride;
+		}
+
+		T keys[stride];
+
+		store<false>(keys, regs + 2);
+
+		merge_strides_tail<T, Compare, Backward, stride>(ptd, keys, ptl, left, ptr, right);
+	}
+
+	SCANDUM_TARGET_AVX512 static void forward_merge(T* array, const T* ptl, size_t left, const T* ptr, size_t right)
+	{
+		merge_strides<false>(array, ptl, left, ptr, right);
+	}
+
+	SCANDUM_TARGET_AVX512 static void backward_merge(T* array, const T* ptl, size_t left, const T* ptr, size_t right)
+	{
+		avx512_network<T, opposite>::template merge_strides<true>(array + left + right - 1, ptl + left - 1, left, ptr + right - 1, right);
+	}
+};
+
+// Merges runs of left and right keys into array with the networks, from their
+// ends when going backward, if the processor has them and the runs are long
+// enough for them to pay. AVX2 has no minimum and maximum of 64 bit integers,
+// which leaves its networks slower than the scalar merges for those.
+
+template<bool Backward, typename T, typename Compare>
+bool network_merge(T* array, const T* ptl, size_t left, const T* ptr, size_t right)
+{
+	switch (cpu_simd_isa())
+	{
+		case simd_isa::avx512:
+			if (left < avx512_network<T, Compare>::stride * 4 || right < avx512_network<T, Compare>::stride * 4)
+			{
+				return false;
+			}
+			Backward ? avx512_network<T, Compare>::backward_merge(array, ptl, left, ptr, right) : avx512_network<T, Compare>::forward_merge(array, ptl, left, ptr, right);
+			return true;
+
+		case simd_isa::avx2:
+			if (sizeof(T) != 4 || left < avx2_network<T, Compare>::stride * 4 || right < avx2_network<T, Compare>::stride * 4)
+			{
+				return false;
+			}
+			Backward ? avx2_network<T, Compare>::backward_merge(array, ptl, left, ptr, right) : avx2_network<T, Compare>::forward_merge(array, ptl, left, ptr, right);
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+#endif
+
+// A sort can't throw when moving, comparing and creating scratch objects
+// can't, and the stack holds the least swap space it falls back on should
+// allocating fail
+
+template<typename T, typename Compare, size_t Least>
+constexpr bool is_nothrow_sortable_v =
+	std::is_nothrow_move_constructible_v<T> &&
+	std::is_nothrow_move_assignable_v<T> &&
+	(!std::is_default_constructible_v<T> || std::is_nothrow_default_constructible_v<T>) &&
+	is_nothrow_compare<T, Compare>::value &&
+	QUAD_STACK / sizeof(T) >= Least;
+
+// A pool of workers for the parallel sorts, each with its own deque of tasks.
+// Workers run their own newest task first and steal the oldest task of
+// another worker when they run out, which in a divide and conquer sort is
+// the largest piece of work left, from workers on their own NUMA node first.
+// Tasks are told which worker runs them, so they can use scratch memory
+// owned by that worker, and can be queued on the worker that owns the part
+// of the array they work on, so that it's mostly touched by one node.
+
+class task_pool {
+public:
+	using task = std::function<void(size_t)>;
+
+	// the tasks a caller waits on, including any tasks they spawn in turn
+
+	struct group {
+		std::atomic<size_t> pending { 0 };
+	};
+
+	explicit task_pool(size_t workers) : queues(std::max<size_t>(workers, 1)) {}
+
+	size_t size() const
+	{
+		return queues.size();
+	}
+
+	// the worker owning the part of an array of nmemb elements that holds index
+
+	size_t owner(size_t index, size_t nmemb) const
+	{
+		return static_cast<size_t>(static_cast<unsigned long long>(index) * size() / nmemb);
+	}
+
+	// records the NUMA node of the calling thread as that of the given worker
+
+	void locate(size_t worker)
+	{
+		queues[worker].node.store(numa_node(), std::memory_order_relaxed);
+	}
+
+	// Queues a task on the given worker, normally the calling one, though any
+	// thread may queue tasks. Throws only when the task can't be queued, in
+	// which case nothing has changed.
+
+	void push(size_t worker, group& owner, task job)
+	{
+		owner.pending.fetch_add(1);
+
+		try
+		{
+			std::lock_guard<std::mutex> lock(queues[worker].mutex);
+			queues[worker].tasks.push_back({ &owner, std::move(job) });
+		}
+		catch (...)
+		{
+			owner.pending.fetch_sub(1);
+			throw;
+		}
+		queued.fetch_add(1);
+
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		idle.notify_one();
+	}
+
+	// wakes every idle worker, after queueing tasks on several workers, so
+	// that each finds its own
+
+	void wake()
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		idle.notify_all();
+	}
+
+	// Runs body(worker) for every worker on the backend, with worker 0 on the
+	// calling thread, until body(0) returns. Worker 0 waits on the work it
+	// hands out, the others run tasks until then. Workers that throw are left
+	// out; an exception from body(0) or from any task is rethrown once all
+	// workers have finished.
+
+	template<typename Body>
+	void run(parallel_backend& backend, Body body)
+	{
+		backend.run(size(), [this, &body](size_t worker)
+		{
+			locate(worker);
+
+			try
+			{
+				body(worker);
+			}
+			catch (...)
+			{
+				if (worker == 0) fail();
+			}
+			if (worker == 0) stop();
+		});
+
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	// whether a task has thrown, in which case later work can be skipped
+
+	bool failed()
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex);
+
+		return error != nullptr;
+	}
+
+	// runs tasks on the given worker until the pool is stopped
+
+	void work(size_t worker)
+	{
+		while (true)
+		{
+			entry next;
+
+			if (take(worker, next))
+			{
+				execute(worker, next);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(idle_mutex);
+			idle.wait(lock, [this] { return queued.load() != 0 || stopped; });
+
+			if (stopped)
+			{
+				return;
+			}
+		}
+	}
+
+	// runs tasks on the given worker until every task in owner has finished
+
+	void wait(size_t worker, group& owner)
+	{
+		while (owner.pending.load() != 0)
+		{
+			entry next;
+
+			if (take(worker, next))
+			{
+				execute(worker, next);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(idle_mutex);
+			idle.wait(lock, [&] { return queued.load() != 0 || owner.pending.load() == 0; });
+		}
+	}
+
+	// wakes every worker and makes work() return once it runs out of tasks
+
+	void stop()
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		stopped = true;
+		idle.notify_all();
+	}
+
+private:
+	struct entry {
+		group* owner;
+		task job;
+	};
+
+	struct alignas(64) queue {
+		std::mutex mutex;
+		std::deque<entry> tasks;
+		std::atomic<size_t> node { 0 };
+	};
+
+	// takes from the worker's own queue, then from the queues of its node,
+	// then from the rest
+
+	bool take(size_t worker, entry& next)
+	{
+		size_t home = queues[worker].node.load(std::memory_order_relaxed);
+
+		for (size_t cnt = 0 ; cnt < size() * 2 ; cnt++)
+		{
+			queue& victim = queues[(worker + cnt) % size()];
+
+			if ((victim.node.load(std::memory_order_relaxed) == home) == (cnt >= size()))
+			{
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(victim.mutex);
+
+			if (victim.tasks.empty())
+			{
+				continue;
+			}
+			if (cnt == 0)
+			{
+				next = std::move(victim.tasks.back());
+				victim.tasks.pop_back();
+			}
+			else
+			{
+				next = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+			}
+			queued.fetch_sub(1);
+			return true;
+		}
+		return false;
+	}
+
+	void execute(size_t worker, entry& next)
+	{
+		try
+		{
+			next.job(worker);
+		}
+		catch (...)
+		{
+			fail();
+		}
+		if (next.owner->pending.fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			idle.notify_all();
+		}
+	}
+
+	// keeps the first exception thrown, to be rethrown by run()
+
+	void fail()
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex);
+
+		if (!error)
+		{
+			error = std::current_exception();
+		}
+	}
+
+	std::vector<queue> queues;
+	std::atomic<size_t> queued { 0 };
+	std::mutex idle_mutex;
+	std::condition_variable idle;
+	std::exception_ptr error;
+	bool stopped = false;
+};
+
+// the least swap space quad_swap() can work with, the rotation merges get by
+// with any amount and shorter arrays only need room for nmemb elements
+
+constexpr size_t quad_swap_min = 32;
+
+// The parity and cross merges run from both ends at once and read elements
+// the other end may already have moved. That is harmless for trivially
+// copyable types, other types are merged front to back with this instead.
+
+template<typename T, typename OutputIt, typename InputIt, typename Compare>
+void forward_merge(OutputIt dest, InputIt from, size_t left, size_t right, Compare cmp)
+{
+	InputIt ptl = from;
+	InputIt ptr = from + left;
+	InputIt tpl = ptr;
+	InputIt tpr = ptr + right;
+
+	while (ptl < tpl && ptr < tpr)
+	{
+		*dest++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+	}
+	while (ptl < tpl)
+	{
+		*dest++ = scandum_move(*ptl++);
+	}
+	while (ptr < tpr)
+	{
+		*dest++ = scandum_move(*ptr++);
+	}
+}
+
+// the next seven functions are used for sorting 0 to 31 elements
+
+template<typename T, typename Iterator, typename Compare>
+void parity_swap_four(Iterator array, Compare cmp)
+{
+	temp_var<T> var(array);
+	T& tmp = var;
+	Iterator pta = array;
+	size_t x;
+
+	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta--;
+
+	if (scandum_greater(cmp, *pta, *(pta + 1)))
+	{
+		tmp = scandum_move(pta[0]); pta[0] = scandum_move(pta[1]); pta[1] = scandum_move(tmp); pta--;
+
+		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+		scandum_branchless_swap(pta, tmp, x, cmp); pta--;
+		scandum_branchless_swap(pta, tmp, x, cmp);
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+void parity_swap_five(Iterator array, Compare cmp)
+{
+	temp_var<T> var(array);
+	T& tmp = var;
+	Iterator pta = array;
+	size_t x, y;
+
+	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+	scandum_branchless_swap(pta, tmp, y, cmp); pta = array;
+
+	if (x + y)
+	{
+		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+		scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1;
+		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+		scandum_branchless_swap(pta, tmp, x, cmp); pta = array;
+		scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+		scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1;
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+void parity_swap_six(Iterator array, swap_space<T>& swap, Compare cmp)
+{
+	temp_var<T> var(array);
+	T& tmp = var;
+	Iterator pta = array;
+	typename swap_space<T>::iterator ptl;
+	typename swap_space<T>::iterator ptr;
+	size_t x, y;
+
+	scandum_branchless_swap(pta, tmp, x, cmp); pta++;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta += 3;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta--;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta = array;
+
+	if (scandum_not_greater(cmp, *(pta + 2), *(pta + 3)))
+	{
+		scandum_branchless_swap(pta, tmp, x, cmp); pta += 4;
+		scandum_branchless_swap(pta, tmp, x, cmp);
+		return;
+	}
+	x = scandum_greater(cmp, *pta, *(pta + 1));
+	y = !x;
+	swap[0] = scandum_move(pta[x]);
+	swap[1] = scandum_move(pta[y]);
+	swap[2] = scandum_move(pta[2]);
+	pta += 4;
+	x = scandum_greater(cmp, *pta, *(pta + 1));
+	y = !x;
+	swap[4] = scandum_move(pta[x]);
+	swap[5] = scandum_move(pta[y]);
+	swap[3] = scandum_move(pta[-1]);
+
+	if constexpr (!std::is_trivially_copyable_v<T>)
+	{
+		forward_merge<T>(array, swap.begin(), 3, 3, cmp);
+		return;
+	}
+	pta = array; ptl = swap.begin(); ptr = swap.begin() + 3;
+
+	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+
+	pta = array + 5; ptl = swap.begin() + 2; ptr = swap.begin() + 5;
+
+	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
+	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
+	*pta = scandum_move(scandum_greater(cmp, *ptl, *ptr) ? *ptl : *ptr);
+}
+
+template<typename T, typename Iterator, typename Compare>
+void parity_swap_seven(Iterator array, swap_space<T>& swap, Compare cmp)
+{
+	temp_var<T> var(array);
+	T& tmp = var;
+	Iterator pta = array;
+	typename swap_space<T>::iterator ptl;
+	typename swap_space<T>::iterator ptr;
+	size_t x, y;
+
+	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta -= 3;
+	scandum_branchless_swap(pta, tmp, y, cmp); pta += 2;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta += 2; y += x;
+	scandum_branchless_swap(pta, tmp, x, cmp); pta -= 1; y += x;
+
+	if (y == 0) return;
+
+	scandum_branchless_swap(pta, tmp, x, cmp); pta = array;
+
+	x = scandum_greater(cmp, *pta, *(pta + 1));
+	swap[0] = scandum_move(pta[x]);
+	swap[1] = scandum_move(pta[!x]);
+	swap[2] = scandum_move(pta[2]);
+	pta += 3;
+	x = scandum_greater(cmp, *pta, *(pta + 1));
+	swap[3] = scandum_move(pta[x]);
+	swap[4] = scandum_move(pta[!x]);
+	pta += 2;
+	x = scandum_greater(cmp, *pta, *(pta + 1));
+	swap[5] = scandum_move(pta[x]);
+	swap[6] = scandum_move(pta[!x]);
+
+	if constexpr (!std::is_trivially_copyable_v<T>)
+	{
+		forward_merge<T>(array, swap.begin(), 3, 4, cmp);
+		return;
+	}
+	pta = array; ptl = swap.begin(); ptr = swap.begin() + 3;
+
+	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+	scandum_head_branchless_merge(pta, x, ptl, ptr, cmp);
+
+	pta = array + 6; ptl = swap.begin() + 2; ptr = swap.begin() + 6;
+
+	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
+	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
+	scandum_tail_branchless_merge(pta, y, ptl, ptr, cmp);
+	*pta = scandum_move(scandum_greater(cmp, *ptl, *ptr) ? *ptl : *ptr);
+}
+
+template<typename T, typename Iterator, typename Compare>
+void tiny_sort(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
+{
+	if (nmemb < 2)
+	{
+		return;
+	}
+	temp_var<T> var(array);
+	T& tmp = var;
+	size_t x;
+
+	switch (nmemb)
+	{
+		case 2:
+			scandum_branchless_swap(array, tmp, x, cmp);
+			return;
+		case 3:
+			scandum_branchless_swap(array, tmp, x, cmp); array++;
+			scandum_branchless_swap(array, tmp, x, cmp); array--;
+			scandum_branchless_swap(array, tmp, x, cmp);
+			return;
+		case 4:
+			parity_swap_four<T>(array, cmp);
+			return;
+		case 5:
+			parity_swap_five<T>(array, cmp);
+			return;
+		case 6:
+			parity_swap_six<T>(array, swap, cmp);
+			return;
+		case 7:
+			parity_swap_seven<T>(array, swap, cmp);
+			return;
+	}
+}
+
+// left must be equal or one smaller than right
+
+template<typename T, typename OutputIt, typename InputIt, typename Compare>
+void parity_merge(OutputIt dest, InputIt from, size_t left, size_t right, Compare cmp)
+{
+	if constexpr (!std::is_trivially_copyable_v<T>)
+	{
+		forward_merge<T>(dest, from, left, right, cmp);
+		return;
+	}
+#ifdef SCANDUM_SIMD
+	if constexpr (is_simd_network_v<T, OutputIt, Compare> && is_simd_network_v<T, InputIt, Compare>)
+	{
+		if (network_merge<false, T, Compare>(dest, from, left, from + left, right))
+		{
+			return;
+		}
+	}
+#endif
+#if !defined __clang__
+	size_t x, y;
+#endif
+	InputIt ptl = from;
+	InputIt ptr = from + left;
+	OutputIt ptd = dest;
+	InputIt tpl = ptr - 1;
+	InputIt tpr = tpl + right;
+	OutputIt tpd = dest + left + right - 1;
+
+	if (left < right)
+	{
+		*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+	}
+	*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+
+#if !defined cmp && !defined __clang__ // cache limit workaround for gcc
+	if (!is_prim_compare_v<Compare> && left > QUAD_CACHE)
+	{
+		while (--left)
+		{
+			*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+			*tpd-- = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? *tpl-- : *tpr--);
+		}
+	}
+	else
+#endif
+	{
+		while (--left)
+		{
+			scandum_head_branchless_merge(ptd, x, ptl, ptr, cmp);
+			scandum_tail_branchless_merge(tpd, y, tpl, tpr, cmp);
+		}
+	}
+	*tpd = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? *tpl : *tpr);
+}
+
+template<typename T, typename Iterator, typename Compare>
+void tail_swap(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
+{
+#ifdef SCANDUM_SIMD
+	if constexpr (is_simd_network_v<T, Iterator, Compare>)
+	{
+		// below 8 keys the latency of the networks exceeds that of tiny_sort()
+
+		if (nmemb >= 8 && nmemb <= 32 && cpu_simd_isa() != simd_isa::scalar)
+		{
+			avx2_network<T, Compare>::sort(array, nmemb);
+			return;
+		}
+	}
+#endif
+	if (nmemb < 8)
+	{
+		tiny_sort<T>(array, swap, nmemb, cmp);
+		return;
+	}
+	size_t quad1, quad2, quad3, quad4, half1, half2;
+
+	half1 = nmemb / 2;
+	quad1 = half1 / 2;
+	quad2 = half1 - quad1;
+	half2 = nmemb - half1;
+	quad3 = half2 / 2;
+	quad4 = half2 - quad3;
+
+	Iterator pta = array;
+
+	tail_swap<T>(pta, swap, quad1, cmp); pta += quad1;
+	tail_swap<T>(pta, swap, quad2, cmp); pta += quad2;
+	tail_swap<T>(pta, swap, quad3, cmp); pta += quad3;
+	tail_swap<T>(pta, swap, quad4, cmp);
+
+	if (scandum_not_greater(cmp, *(array + quad1 - 1), *(array + quad1)) && scandum_not_greater(cmp, *(array + half1 - 1), *(array + half1)) && scandum_not_greater(cmp, *(pta - 1), *pta))
+	{
+		return;
+	}
+	parity_merge<T>(swap.begin(), array, quad1, quad2, cmp);
+	parity_merge<T>(swap.begin() + half1, array + half1, quad3, quad4, cmp);
+	parity_merge<T>(array, swap.begin(), half1, half2, cmp);
+}
+
+// the next three functions create sorted blocks of 32 elements
+
+template<typename T, typename Iterator>
+void quad_reversal(Iterator pta, Iterator ptz)
+{
+	Iterator ptb, pty;
+	temp_var<T> var1(pta), var2(pta);
+	T& tmp1 = var1;
+	T& tmp2 = var2;
+
+	size_t loop = (ptz - pta) / 2;
+
+	ptb = pta + loop;
+	pty = ptz - loop;
+
+	if (loop % 2 == 0)
+	{
+		tmp2 = scandum_move(*ptb); *ptb-- = scandum_move(*pty); *pty++ = scandum_move(tmp2); loop--;
+	}
+
+	loop /= 2;
+
+	do
+	{
+		tmp1 = scandum_move(*pta); *pta++ = scandum_move(*ptz); *ptz-- = scandum_move(tmp1);
+		tmp2 = scandum_move(*ptb); *ptb-- = scandum_move(*pty); *pty++ = scandum_move(tmp2);
+	} while (loop--);
+}
+
+template<typename T, typename Iterator, typename Compare>
+void quad_swap_merge(Iterator array, swap_space<T>& swap, Compare cmp)
+{
+#ifdef SCANDUM_SIMD
+	if constexpr (is_simd_network_v<T, Iterator, Compare>)
+	{
+		if (cpu_simd_isa() != simd_isa::scalar)
+		{
+			avx2_network<T, Compare>::sort(array, 8);
+			return;
+		}
+	}
+#endif
+	if constexpr (!std::is_trivially_copyable_v<T>)
+	{
+		forward_merge<T>(swap.begin() + 0, array + 0, 2, 2, cmp);
+		forward_merge<T>(swap.begin() + 4, array + 4, 2, 2, cmp);
+		forward_merge<T>(array, swap.begin(), 4, 4, cmp);
+		return;
+	}
+	typename swap_space<T>::iterator pts;
+	Iterator ptl;
+	Iterator ptr;
+#if !defined __clang__
+	size_t x;
+#endif
+	scandum_parity_merge_two(array + 0, swap.begin() + 0, x, ptl, ptr, pts, cmp);
+	scandum_parity_merge_two(array + 4, swap.begin() + 4, x, ptl, ptr, pts, cmp);
+
+	Iterator pts2;
+	typename swap_space<T>::iterator ptl2;
+	typename swap_space<T>::iterator ptr2;
+	scandum_parity_merge_four(swap.begin(), array, x, ptl2, ptr2, pts2, cmp);
+}
+
+template<typename T, typename Iterator, typename Compare>
+void partial_backward_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp);
+
+template<typename T, typename Iterator, typename Compare>
+void tail_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
+{
+	Iterator pta, pte;
+
+	pte = array + nmemb;
+
+	while (block < nmemb && block <= swap.size())
+	{
+		for (pta = array ; block < pte - pta; pta += block * 2)
+		{
+			if (block * 2 < pte - pta)
+			{
+				partial_backward_merge<T>(pta, swap, block * 2, block, cmp);
+
+				continue;
+			}
+			partial_backward_merge<T>(pta, swap, pte - pta, block, cmp);
+
+			break;
+		}
+		block *= 2;
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+size_t quad_swap(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
+{
+	temp_var<T> var(array);
+	T& tmp = var;
+	size_t count;
+	Iterator pta, pts;
+	unsigned char v1, v2, v3, v4, x;
+	pta = array;
+
+	count = nmemb / 8;
+
+	while (count--)
+	{
+		v1 = scandum_greater(cmp, *(pta + 0), *(pta + 1));
+		v2 = scandum_greater(cmp, *(pta + 2), *(pta + 3));
+		v3 = scandum_greater(cmp, *(pta + 4), *(pta + 5));
+		v4 = scandum_greater(cmp, *(pta + 6), *(pta + 7));
+
+		switch (v1 + v2 * 2 + v3 * 4 + v4 * 8)
+		{
+			case 0:
+				if (scandum_not_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_not_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_not_greater(cmp, *(pta + 5), *(pta + 6)))
+				{
+					goto ordered;
+				}
+				quad_swap_merge<T>(pta, swap, cmp);
+				break;
+
+			case 15:
+				if (scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
+				{
+					pts = pta;
+					goto reversed;
+				}
+
+			default:
+			not_ordered:
+				scandum_swap_pair(pta, tmp, v1); pta += 2;
+				scandum_swap_pair(pta, tmp, v2); pta += 2;
+				scandum_swap_pair(pta, tmp, v3); pta += 2;
+				scandum_swap_pair(pta, tmp, v4); pta -= 6;
+
+				quad_swap_merge<T>(pta, swap, cmp);
+			}
+			pta += 8;
+
+			continue;
+
+		ordered:
+
+			pta += 8;
+
+			if (count--)
+			{
+				if ((v1 = scandum_greater(cmp, *(pta + 0), *(pta + 1))) | (v2 = scandum_greater(cmp, *(pta + 2), *(pta + 3))) | (v3 = scandum_greater(cmp, *(pta + 4), *(pta + 5))) | (v4 = scandum_greater(cmp, *(pta + 6), *(pta + 7))))
+				{
+					if (v1 + v2 + v3 + v4 == 4 && scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
+					{
+						pts = pta;
+						goto reversed;
+					}
+					goto not_ordered;
+				}
+				if (scandum_not_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_not_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_not_greater(cmp, *(pta + 5), *(pta + 6)))
+				{
+					goto ordered;
+				}
+				quad_swap_merge<T>(pta, swap, cmp);
+				pta += 8;
+				continue;
+			}
+			break;
+
+		reversed:
+
+			pta += 8;
+
+			if (count--)
+			{
+				if ((v1 = scandum_not_greater(cmp, *(pta + 0), *(pta + 1))) | (v2 = scandum_not_greater(cmp, *(pta + 2), *(pta + 3))) | (v3 = scandum_not_greater(cmp, *(pta + 4), *(pta + 5))) | (v4 = scandum_not_greater(cmp, *(pta + 6), *(pta + 7))))
+				{
+					// not reversed
+				}
+				else
+				{
+					if (scandum_greater(cmp, *(pta - 1), *pta) && scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
+					{
+						goto reversed;
+					}
+				}
+				quad_reversal<T>(pts, pta - 1);
+
+				if (v1 + v2 + v3 + v4 == 4 && scandum_not_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_not_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_not_greater(cmp, *(pta + 5), *(pta + 6)))
+				{
+					goto ordered;
+				}
+				if (v1 + v2 + v3 + v4 == 0 && scandum_greater(cmp, *(pta + 1), *(pta + 2)) && scandum_greater(cmp, *(pta + 3), *(pta + 4)) && scandum_greater(cmp, *(pta + 5), *(pta + 6)))
+				{
+					pts = pta;
+					goto reversed;
+				}
+
+				x = !v1; scandum_swap_pair(pta, tmp, x); pta += 2;
+				x = !v2; scandum_swap_pair(pta, tmp, x); pta += 2;
+				x = !v3; scandum_swap_pair(pta, tmp, x); pta += 2;
+				x = !v4; scandum_swap_pair(pta, tmp, x); pta -= 6;
+
+				if (scandum_greater(cmp, *(pta + 1), *(pta + 2)) || scandum_greater(cmp, *(pta + 3), *(pta + 4)) || scandum_greater(cmp, *(pta + 5), *(pta + 6)))
+				{
+					quad_swap_merge<T>(pta, swap, cmp);
+				}
+				pta += 8;
+				continue;
+		}
+
+		switch (nmemb % 8)
+		{
+			case 7: if (scandum_not_greater(cmp, *(pta + 5), *(pta + 6))) break;
+			case 6: if (scandum_not_greater(cmp, *(pta + 4), *(pta + 5))) break;
+			case 5: if (scandum_not_greater(cmp, *(pta + 3), *(pta + 4))) break;
+			case 4: if (scandum_not_greater(cmp, *(pta + 2), *(pta + 3))) break;
+			case 3: if (scandum_not_greater(cmp, *(pta + 1), *(pta + 2))) break;
+			case 2: if (scandum_not_greater(cmp, *(pta + 0), *(pta + 1))) break;
+			case 1: if (scandum_not_greater(cmp, *(pta - 1), *(pta + 0))) break;
+			case 0:
+				quad_reversal<T>(pts, pta + nmemb % 8 - 1);
+
+				if (pts == array)
+				{
+					return 1;
+				}
+				goto reverse_end;
+		}
+		quad_reversal<T>(pts, pta - 1);
+		break;
+	}
+	tail_swap<T>(pta, swap, nmemb % 8, cmp);
+
+reverse_end:
+
+	pta = array;
+
+	for (count = nmemb / 32 ; count-- ; pta += 32)
+	{
+		if (scandum_not_greater(cmp, *(pta + 7), *(pta + 8)) && scandum_not_greater(cmp, *(pta + 15), *(pta + 16)) && scandum_not_greater(cmp, *(pta + 23), *(pta + 24)))
+		{
+			continue;
+		}
+#ifdef SCANDUM_SIMD
+		if constexpr (is_simd_network_v<T, Iterator, Compare>)
+		{
+			if (cpu_simd_isa() != simd_isa::scalar)
+			{
+				avx2_network<T, Compare>::merge32(pta);
+				continue;
+			}
+		}
+#endif
+		parity_merge<T>(swap.begin(), pta, 8, 8, cmp);
+		parity_merge<T>(swap.begin() + 16, pta + 16, 8, 8, cmp);
+		parity_merge<T>(pta, swap.begin(), 16, 16, cmp);
+	}
+
+	if (nmemb % 32 > 8)
+	{
+		tail_merge<T>(pta, swap, nmemb % 32, 8, cmp);
+	}
+	return 0;
+}
+
+// The next six functions are quad merge support routines
+
+template<typename T, typename OutputIt, typename InputIt, typename Compare>
+void cross_merge(OutputIt dest, InputIt from, size_t left, size_t right, Compare cmp)
+{
+	if constexpr (!std::is_trivially_copyable_v<T>)
+	{
+		forward_merge<T>(dest, from, left, right, cmp);
+		return;
+	}
+	size_t loop;
+#if !defined __clang__
+	size_t x, y;
+#endif
+	InputIt ptl = from;
+	InputIt ptr = from + left;
+	InputIt tpl = ptr - 1;
+	InputIt tpr = tpl + right;
+
+	if (left + 1 >= right && right >= left && left >= 32)
+	{
+		if (scandum_greater(cmp, *(ptl + 15), *ptr) && scandum_not_greater(cmp, *ptl, *(ptr + 15)) && scandum_greater(cmp, *tpl, *(tpr - 15)) && scandum_not_greater(cmp, *(tpl - 15), *tpr))
+		{
+			parity_merge<T>(dest, from, left, right, cmp);
+			return;
+		}
+	}
+#ifdef SCANDUM_SIMD
+	if constexpr (is_simd_network_v<T, OutputIt, Compare> && is_simd_network_v<T, InputIt, Compare>)
+	{
+		// runs of unequal length that interleave at both ends
+
+		if (left >= 32 && right >= 32)
+		{
+			if (scandum_greater(cmp, *(ptl + 15), *ptr) && scandum_not_greater(cmp, *ptl, *(ptr + 15)) && scandum_greater(cmp, *tpl, *(tpr - 15)) && scandum_not_greater(cmp, *(tpl - 15), *tpr))
+			{
+				if (network_merge<false, T, Compare>(dest, from, left, from + left, right))
+				{
+					return;
+				}
+			}
+		}
+	}
+#endif
+	OutputIt ptd = dest;
+	OutputIt tpd = dest + left + right - 1;
+
+	while (1)
+	{
+		if (tpl - ptl > 8)
+		{
+		ptl8_ptr:
+			if (scandum_not_greater(cmp, *(ptl + 7), *ptr))
+			{
+				scandum_copy_range(T, ptd, ptl, 8); ptd += 8; ptl += 8;
+
+				if (tpl - ptl > 8) { goto ptl8_ptr; } continue;
+			}
+
+		tpl8_tpr:
+			if (scandum_greater(cmp, *(tpl - 7), *tpr))
+			{
+				tpd -= 7; tpl -= 7; scandum_copy_range(T, tpd--, tpl--, 8);
+
+				if (tpl - ptl > 8) { goto tpl8_tpr; } continue;
+			}
+		}
+
+		if (tpr - ptr > 8)
+		{
+		ptl_ptr8:
+			if (scandum_greater(cmp, *ptl, *(ptr + 7)))
+			{
+				scandum_copy_range(T, ptd, ptr, 8); ptd += 8; ptr += 8;
+
+				if (tpr - ptr > 8) { goto ptl_ptr8; } continue;
+			}
+
+		tpl_tpr8:
+			if (scandum_not_greater(cmp, *tpl, *(tpr - 7)))
+			{
+				tpd -= 7; tpr -= 7; scandum_copy_range(T, tpd--, tpr--, 8);
+
+				if (tpr - ptr > 8) { goto tpl_tpr8; } continue;
+			}
+		}
+
+		if (tpd - ptd < 16)
+		{
+			break;
+		}
+
+#if !defined cmp && !defined __clang__
+		if (!is_prim_compare_v<Compare> && left > QUAD_CACHE)
+		{
+			loop = 8; do
+			{
+				*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+				*tpd-- = scandum_move(scandum_greater(cmp, *tpl, *tpr) ? *tpl-- : *tpr--);
+			} while (--loop);
+		}
+		else
+#endif
+		{
+			loop = 8; do
+			{
+				scandum_head_branchless_merge(ptd, x, ptl, ptr, cmp);
+				scandum_tail_branchless_merge(tpd, y, tpl, tpr, cmp);
+			} while (--loop);
+		}
+	}
+
+	while (ptl <= tpl && ptr <= tpr)
+	{
+		*ptd++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+	}
+	while (ptl <= tpl)
+	{
+		*ptd++ = scandum_move(*ptl++);
+	}
+	while (ptr <= tpr)
+	{
+		*ptd++ = scandum_move(*ptr++);
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+void quad_merge_block(Iterator array, swap_space<T>& swap, size_t block, Compare cmp)
+{
+	Iterator pt1, pt2, pt3;
+	size_t block_x_2 = block * 2;
+
+	pt1 = array + block;
+	pt2 = pt1 + block;
+	pt3 = pt2 + block;
+
+	switch ((scandum_not_greater(cmp, *(pt1 - 1), *pt1)) | (scandum_not_greater(cmp, *(pt3 - 1), *pt3)) * 2)
+	{
+		case 0:
+			cross_merge<T>(swap.begin(), array, block, block, cmp);
+			cross_merge<T>(swap.begin() + block_x_2, pt2, block, block, cmp);
+			break;
+		case 1:
+			scandum_copy_range(T, swap.begin(), array, block_x_2);
+			cross_merge<T>(swap.begin() + block_x_2, pt2, block, block, cmp);
+			break;
+		case 2:
+			cross_merge<T>(swap.begin(), array, block, block, cmp);
+			scandum_copy_range(T, swap.begin() + block_x_2, pt2, block_x_2);
+			break;
+		case 3:
+			if (scandum_not_greater(cmp, *(pt2 - 1), *pt2))
+				return;
+			scandum_copy_range(T, swap.begin(), array, block_x_2 * 2);
+	}
+	cross_merge<T>(array, swap.begin(), block_x_2, block_x_2, cmp);
+}
+
+template<typename T, typename Iterator, typename Compare>
+size_t quad_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
+{
+	Iterator pta, pte;
+
+	pte = array + nmemb;
+
+	block *= 4;
+
+	while (block <= nmemb && block <= swap.size())
+	{
+		pta = array;
+
+		do
+		{
+			quad_merge_block<T>(pta, swap, block / 4, cmp);
+
+			pta += block;
+		} while ((size_t)(pte - pta) >= block);
+
+		tail_merge<T>(pta, swap, pte - pta, block / 4, cmp);
+
+		block *= 4;
+	}
+
+	tail_merge<T>(array, swap, nmemb, block / 4, cmp);
+
+	return block / 2;
+}
+
+template<typename T, typename Iterator, typename Compare>
+void partial_forward_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
+{
+	typename swap_space<T>::iterator ptl, tpl;
+	Iterator ptr, tpr;
+	size_t x;
+
+	if (nmemb == block)
+	{
+		return;
+	}
+
+	ptr = array + block;
+	tpr = array + nmemb - 1;
+
+	if (scandum_not_greater(cmp, *(ptr - 1), *ptr))
+	{
+		return;
+	}
+
+	scandum_copy_range(T, swap.begin(), array, block);
+#ifdef SCANDUM_SIMD
+	if constexpr (is_simd_network_v<T, Iterator, Compare>)
+	{
+		if (network_merge<false, T, Compare>(array, swap.begin(), block, ptr, nmemb - block))
+		{
+			return;
+		}
+	}
+#endif
+	ptl = swap.begin();
+	tpl = swap.begin() + block - 1;
+
+	while (ptl < tpl - 1 && ptr < tpr - 1)
+	{
+	ptr2:
+		if (scandum_greater(cmp, *ptl, *(ptr + 1)))
+		{
+			*array++ = scandum_move(*ptr++); *array++ = scandum_move(*ptr++);
+
+			if (ptr < tpr - 1) { goto ptr2; } break;
+		}
+		if (scandum_not_greater(cmp, *(ptl + 1), *ptr))
+		{
+			*array++ = scandum_move(*ptl++); *array++ = scandum_move(*ptl++);
+
+			if (ptl < tpl - 1) { goto ptl2; } break;
+		}
+
+		goto cross_swap;
+
+	ptl2:
+		if (scandum_not_greater(cmp, *(ptl + 1), *ptr))
+		{
+			*array++ = scandum_move(*ptl++); *array++ = scandum_move(*ptl++);
+
+			if (ptl < tpl - 1) { goto ptl2; } break;
+		}
+
+		if (scandum_greater(cmp, *ptl, *(ptr + 1)))
+		{
+			*array++ = scandum_move(*ptr++); *array++ = scandum_move(*ptr++);
+
+			if (ptr < tpr - 1) { goto ptr2; } break;
+		}
+
+	cross_swap:
+
+		x = scandum_not_greater(cmp, *ptl, *ptr);
+		array[x] = scandum_move(*ptr);
+		ptr += 1;
+		array[!x] = scandum_move(*ptl);
+		ptl += 1;
+		array += 2;
+		scandum_head_branchless_merge(array, x, ptl, ptr, cmp);
+	}
+
+	while (ptl <= tpl && ptr <= tpr)
+	{
+		*array++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? (T&)*ptl++ : (T&)*ptr++);
+	}
+
+	while (ptl <= tpl)
+	{
+		*array++ = scandum_move(*ptl++);
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+void partial_backward_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
+{
+	Iterator tpl, tpa;
+	typename swap_space<T>::iterator tpr;
+	size_t right, loop, x;
+
+	if (nmemb == block)
+	{
+		return;
+	}
+
+	tpl = array + block - 1;
+	tpa = array + nmemb - 1;
+
+	if (scandum_not_greater(cmp, *tpl, *(tpl + 1)))
+	{
+		return;
+	}
+
+	right = nmemb - block;
 
 	if (nmemb <= swap.size() && right >= 64)
 	{
-		cross_merge<T>(swap.begin(), array, block, right, cmp);
+		cross_merge<T>(swap.begin(), array, block, right, cmp);
+
+		scandum_copy_range(T, array, swap.begin(), nmemb);
+
+		return;
+	}
+
+	scandum_copy_range(T, swap.begin(), array + block, right);
+#ifdef SCANDUM_SIMD
+	if constexpr (is_simd_network_v<T, Iterator, Compare>)
+	{
+		if (network_merge<true, T, Compare>(array, array, block, swap.begin(), right))
+		{
+			return;
+		}
+	}
+#endif
+	tpr = swap.begin() + right - 1;
+
+	while (tpl > array + 16 && tpr > swap.begin() + 16)
+	{
+	tpl_tpr16:
+		if (scandum_not_greater(cmp, *tpl, *(tpr - 15)))
+		{
+			loop = 16; do *tpa-- = scandum_move(*tpr--); while (--loop);
+
+			if (tpr > swap.begin() + 16) { goto tpl_tpr16; } break;
+		}
+
+	tpl16_tpr:
+		if (scandum_greater(cmp, *(tpl - 15), *tpr))
+		{
+			loop = 16; do *tpa-- = scandum_move(*tpl--); while (--loop);
+
+			if (tpl > array + 16) { goto tpl16_tpr; } break;
+		}
+	loop = 8;
+		do
+		{
+			if (scandum_not_greater(cmp, *tpl, *(tpr - 1)))
+			{
+				*tpa-- = scandum_move(*tpr--); *tpa-- = scandum_move(*tpr--);
+			}
+			else if (scandum_greater(cmp, *(tpl - 1), *tpr))
+			{
+				*tpa-- = scandum_move(*tpl--); *tpa-- = scandum_move(*tpl--);
+			}
+			else
+			{
+				x = scandum_not_greater(cmp, *tpl, *tpr);
+				tpa--;
+				tpa[x] = scandum_move(*tpr);
+				tpr -= 1;
+				tpa[!x] = scandum_move(*tpl);
+				tpl -= 1;
+				tpa--;
+				scandum_tail_branchless_merge(tpa, x, tpl, tpr, cmp);
+			}
+		} while (--loop);
+	}
+
+	while (tpr > swap.begin() + 1 && tpl > array + 1)
+	{
+	tpr2:
+		if (scandum_not_greater(cmp, *tpl, *(tpr - 1)))
+		{
+			*tpa-- = scandum_move(*tpr--); *tpa-- = scandum_move(*tpr--);
+
+			if (tpr > swap.begin() + 1) { goto tpr2; } break;
+		}
+
+		if (scandum_greater(cmp, *(tpl - 1), *tpr))
+		{
+			*tpa-- = scandum_move(*tpl--); *tpa-- = scandum_move(*tpl--);
+
+			if (tpl > array + 1) { goto tpl2; } break;
+		}
+		goto cross_swap;
+
+	tpl2:
+		if (scandum_greater(cmp, *(tpl - 1), *tpr))
+		{
+			*tpa-- = scandum_move(*tpl--); *tpa-- = scandum_move(*tpl--);
+
+			if (tpl > array + 1) { goto tpl2; } break;
+		}
+
+		if (scandum_not_greater(cmp, *tpl, *(tpr - 1)))
+		{
+			*tpa-- = scandum_move(*tpr--); *tpa-- = scandum_move(*tpr--);
+
+			if (tpr > swap.begin() + 1) { goto tpr2; } break;
+		}
+	cross_swap:
+
+		x = scandum_not_greater(cmp, *tpl, *tpr);
+		tpa--;
+		tpa[x] = scandum_move(*tpr);
+		tpr -= 1;
+		tpa[!x] = scandum_move(*tpl);
+		tpl -= 1;
+		tpa--;
+		scandum_tail_branchless_merge(tpa, x, tpl, tpr, cmp);
+	}
+
+	// TODO: this logic is really ugly and branchy and can probably be simplified
+	while (tpr >= swap.begin() && tpl >= array) {
+		if (scandum_greater(cmp, *tpl, *tpr)) {
+			*tpa = scandum_move((T&)*tpl); --tpa;
+			if (tpl > array) { --tpl; } else break;
+		} else {
+			*tpa = scandum_move((T&)*tpr);
+			if (tpr > swap.begin()) { --tpr; --tpa; } else return;
+		}
+	}
+
+	if (tpr >= swap.begin()) {
+		*tpa = scandum_move(*tpr);
+		while (tpr > swap.begin())
+		{
+			*--tpa = scandum_move(*--tpr);
+		}
+	}
+}
+
+// the next four functions provide in-place rotate merge support
+
+template<typename T, typename Iterator>
+void trinity_rotation(Iterator array, swap_space<T>& swap, size_t nmemb, size_t left)
+{
+	temp_var<T> var(array);
+	T& temp = var;
+	size_t bridge, right = nmemb - left;
+
+	size_t swap_size = swap.size() < 65536 ? swap.size() : 65536;
+
+	if (left < right)
+	{
+		if (left <= swap_size)
+		{
+			scandum_copy_range(T, swap.begin(), array, left);
+			scandum_copy_overlapping_range(T, array, array + left, right);
+			scandum_copy_range(T, array + right, swap.begin(), left);
+		}
+		else
+		{
+			Iterator pta, ptb, ptc, ptd;
+
+			pta = array;
+			ptb = pta + left;
+
+			bridge = right - left;
+
+			if (bridge <= swap_size && bridge > 3)
+			{
+				ptc = pta + right;
+				ptd = ptc + left;
+
+				scandum_copy_range(T, swap.begin(), ptb, bridge);
+
+				while (left--)
+				{
+					*--ptc = scandum_move(*--ptd); *ptd = scandum_move(*--ptb);
+				}
+				scandum_copy_range(T, pta, swap.begin(), bridge);
+			}
+			else
+			{
+				ptc = ptb;
+				ptd = ptc + right;
+
+				bridge = left / 2;
+
+				while (bridge--)
+				{
+					temp = scandum_move(*--ptb);
+					*ptb = scandum_move(*pta);
+					*pta++ = scandum_move(*ptc);
+					*ptc++ = scandum_move(*--ptd);
+					*ptd = scandum_move(temp);
+				}
+
+				bridge = (ptd - ptc) / 2;
+
+				while (bridge--)
+				{
+					temp = scandum_move(*ptc);
+					*ptc++ = scandum_move(*--ptd);
+					*ptd = scandum_move(*pta);
+					*pta++ = scandum_move(temp);
+				}
+
+				bridge = (ptd - pta) / 2;
+
+				while (bridge--)
+				{
+					temp = scandum_move(*pta);
+					*pta++ = scandum_move(*--ptd);
+					*ptd = scandum_move(temp);
+				}
+			}
+		}
+	}
+	else if (right < left)
+	{
+		if (right <= swap_size)
+		{
+			scandum_copy_range(T, swap.begin(), array + left, right);
+			scandum_copy_overlapping_range(T, array + right, array, left);
+			scandum_copy_range(T, array, swap.begin(), right);
+		}
+		else
+		{
+			Iterator pta, ptb, ptc, ptd;
+
+			pta = array;
+			ptb = pta + left;
+
+			bridge = left - right;
+
+			if (bridge <= swap_size && bridge > 3)
+			{
+				ptc = pta + right;
+				ptd = ptc + left;
+
+				scandum_copy_range(T, swap.begin(), ptc, bridge);
+
+				while (right--)
+				{
+					*ptc++ = scandum_move(*pta); *pta++ = scandum_move(*ptb++);
+				}
+				scandum_copy_range(T, ptd - bridge, swap.begin(), bridge);
+			}
+			else
+			{
+				ptc = ptb;
+				ptd = ptc + right;
+
+				bridge = right / 2;
+
+				while (bridge--)
+				{
+					temp = scandum_move(*--ptb);
+					*ptb = scandum_move(*pta);
+					*pta++ = scandum_move(*ptc);
+					*ptc++ = scandum_move(*--ptd);
+					*ptd = scandum_move(temp);
+				}
+
+				bridge = (ptb - pta) / 2;
+
+				while (bridge--)
+				{
+					temp = scandum_move(*--ptb);
+					*ptb = scandum_move(*pta);
+					*pta++ = scandum_move(*--ptd);
+					*ptd = scandum_move(temp);
+				}
+
+				bridge = (ptd - pta) / 2;
+
+				while (bridge--)
+				{
+					temp = scandum_move(*pta);
+					*pta++ = scandum_move(*--ptd);
+					*ptd = scandum_move(temp);
+				}
+			}
+		}
+	}
+	else
+	{
+		Iterator pta, ptb;
+
+		pta = array;
+		ptb = pta + left;
+
+		while (left--)
+		{
+			temp = scandum_move(*pta);
+			*pta++ = scandum_move(*ptb);
+			*ptb++ = scandum_move(temp);
+		}
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+size_t monobound_binary_first(Iterator array, Iterator value, size_t top, Compare cmp)
+{
+	size_t mid;
+	Iterator end = array + top;
+
+	while (top > 1)
+	{
+		mid = top / 2;
+
+		if (scandum_not_greater(cmp, *value, *(end - mid)))
+		{
+			end -= mid;
+		}
+		top -= mid;
+	}
+
+	if (scandum_not_greater(cmp, *value, *(end - 1)))
+	{
+		end--;
+	}
+	return (end - array);
+}
+
+template<typename T, typename Iterator, typename Compare>
+void rotate_merge_block(Iterator array, swap_space<T>& swap, size_t lblock, size_t right, Compare cmp)
+{
+	size_t left, rblock, unbalanced;
+
+	if (scandum_not_greater(cmp, *(array + lblock - 1), *(array + lblock)))
+	{
+		return;
+	}
+
+	rblock = lblock / 2;
+	lblock -= rblock;
+
+	left = monobound_binary_first<T>(array + lblock + rblock, array + lblock, right, cmp);
+
+	right -= left;
+
+	// [ lblock ] [ rblock ] [ left ] [ right ]
+
+	if (left)
+	{
+		if (lblock + left <= swap.size())
+		{
+			scandum_copy_range(T, swap.begin(), array, lblock);
+			scandum_copy_range(T, swap.begin() + lblock, array + lblock + rblock, left);
+			scandum_copy_overlapping_range(T, array + lblock + left, array + lblock, rblock);
+
+			cross_merge<T>(array, swap.begin(), lblock, left, cmp);
+		}
+		else
+		{
+			trinity_rotation<T>(array + lblock, swap, rblock + left, rblock);
+
+			unbalanced = (left * 2 < lblock) | (lblock * 2 < left);
+
+			if (unbalanced && left <= swap.size())
+			{
+				partial_backward_merge<T>(array, swap, lblock + left, lblock, cmp);
+			}
+			else if (unbalanced && lblock <= swap.size())
+			{
+				partial_forward_merge<T>(array, swap, lblock + left, lblock, cmp);
+			}
+			else
+			{
+				rotate_merge_block<T>(array, swap, lblock, left, cmp);
+			}
+		}
+	}
+
+	if (right)
+	{
+		unbalanced = (right * 2 < rblock) | (rblock * 2 < right);
+
+		if ((unbalanced && right <= swap.size()) || right + rblock <= swap.size())
+		{
+			partial_backward_merge<T>(array + lblock + left, swap, rblock + right, rblock, cmp);
+		}
+		else if (unbalanced && rblock <= swap.size())
+		{
+			partial_forward_merge<T>(array + lblock + left, swap, rblock + right, rblock, cmp);
+		}
+		else
+		{
+			rotate_merge_block<T>(array + lblock + left, swap, rblock, right, cmp);
+		}
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+void rotate_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
+{
+	Iterator pta, pte;
+
+	pte = array + nmemb;
+
+	if (nmemb <= block * 2 && nmemb - block <= swap.size())
+	{
+		partial_backward_merge<T>(array, swap, nmemb, block, cmp);
+
+		return;
+	}
+
+	while (block < nmemb)
+	{
+		for (pta = array ; (size_t)(pte - pta) > block ; pta += block * 2)
+		{
+			if ((size_t)(pte - pta) > block * 2)
+			{
+				rotate_merge_block<T>(pta, swap, block, block, cmp);
+
+				continue;
+			}
+			rotate_merge_block<T>(pta, swap, block, pte - pta - block, cmp);
+
+			break;
+		}
+		block *= 2;
+	}
+}
+
+template<typename T, typename Iterator, typename Compare>
+void quadsort_swap(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
+{
+	Iterator pta = array;
+
+	if (nmemb <= 96)
+	{
+		tail_swap<T>(pta, swap, nmemb, cmp);
+	}
+	else if (quad_swap<T>(pta, swap, nmemb, cmp) == 0)
+	{
+		size_t block = quad_merge<T>(pta, swap, nmemb, 32, cmp);
+
+		rotate_merge<T>(pta, swap, nmemb, block, cmp);
+	}
+}
+
+// quadsort() merges with up to this many elements of swap space
+
+inline size_t quad_swap_size(size_t nmemb)
+{
+	size_t swap_size = nmemb;
+
+	if (nmemb > 4194304) for (swap_size = 4194304 ; swap_size * 8 <= nmemb ; swap_size *= 4) {}
+
+	return swap_size;
+}
+
+// quadsort() on a swap space of any size, provided it holds min(nmemb, 32) elements
+
+template<typename T, typename Iterator, typename Compare>
+void quadsort_scratch(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
+{
+	if (nmemb < 32)
+	{
+		tail_swap<T>(array, swap, nmemb, cmp);
+	}
+	else if (quad_swap<T>(array, swap, nmemb, cmp) == 0)
+	{
+		size_t block = quad_merge<T>(array, swap, nmemb, 32, cmp);
+
+		rotate_merge<T>(array, swap, nmemb, block, cmp);
+	}
+}
+
+// quadsort() with at most max_swap elements of swap space, though never less
+// than min(nmemb, 32). The merges fall back on rotations for whatever doesn't
+// fit. Returns the most elements of swap space in use at any one time.
+
+template<typename T, typename Iterator, typename Compare>
+size_t quadsort_limited(Iterator array, size_t nmemb, size_t max_swap, Compare cmp, const scratch_allocator* source = nullptr)
+{
+	stack_swap<T, quad_swap_min> stack;
+
+	if (nmemb < 32)
+	{
+		swap_space<T> swap(nmemb, nmemb, stack, array, source);
+
+		tail_swap<T>(array, swap, nmemb, cmp);
+
+		return swap.size();
+	}
+
+	{
+		swap_space<T> quad(quad_swap_min, quad_swap_min, stack, array, source);
+
+		if (quad_swap<T>(array, quad, nmemb, cmp))
+		{
+			return quad.size();
+		}
+	}
+	size_t block;
+
+	swap_space<T> swap(std::max(std::min(quad_swap_size(nmemb), max_swap), quad_swap_min), quad_swap_min, stack, array, source);
+
+	block = quad_merge<T>(array, swap, nmemb, 32, cmp);
+
+	rotate_merge<T>(array, swap, nmemb, block, cmp);
+
+	return std::max(swap.size(), quad_swap_min);
+}
+
+// The number of elements the first k elements of the stable merge of left and
+// right take from left. Finding it for the start and end of a stretch of the
+// output, a thread can merge that stretch without regard to the others.
+
+template<typename LeftIt, typename RightIt, typename Compare>
+size_t merge_path_rank(LeftIt left, size_t lsize, RightIt right, size_t rsize, size_t k, Compare cmp)
+{
+	size_t bot = k > rsize ? k - rsize : 0;
+	size_t top = std::min(k, lsize);
+
+	while (bot < top)
+	{
+		size_t mid = bot + (top - bot) / 2;
+
+		// left[mid] comes before right[k - mid - 1], so more of left is taken
+
+		if (scandum_not_greater(cmp, *(left + mid), *(right + (k - mid - 1))))
+		{
+			bot = mid + 1;
+		}
+		else
+		{
+			top = mid;
+		}
+	}
+	return bot;
+}
+
+template<typename OutputIt, typename LeftIt, typename RightIt, typename Compare>
+void merge_path_merge(OutputIt dest, LeftIt ptl, size_t lsize, RightIt ptr, size_t rsize, Compare cmp)
+{
+	LeftIt tpl = ptl + lsize;
+	RightIt tpr = ptr + rsize;
+
+	while (ptl < tpl && ptr < tpr)
+	{
+		*dest++ = scandum_move(scandum_not_greater(cmp, *ptl, *ptr) ? *ptl++ : *ptr++);
+	}
+	while (ptl < tpl)
+	{
+		*dest++ = scandum_move(*ptl++);
+	}
+	while (ptr < tpr)
+	{
+		*dest++ = scandum_move(*ptr++);
+	}
+}
 
-		scandum_copy_range(T, array, swap.begin(), nmemb);
+// Writes to every page of uninitialized swap space, so that the pages are
+// placed on the NUMA node of the calling thread, not of whichever thread
+// writes to them first later on
 
-		return;
+template<typename T>
+void first_touch(T* begin, T* end)
+{
+	static_assert(std::is_trivially_copyable_v<T>, "only swap space in raw storage can be written to");
+
+	for (char* page = reinterpret_cast<char*>(begin) ; page < reinterpret_cast<char*>(end) ; page += 4096)
+	{
+		*page = 0;
 	}
+}
 
-	scandum_copy_range(T, swap.begin(), array + block, right);
+// Merges every pair of neighbouring runs of block elements from the array
+// into dest, on as many tasks as there are stretches of piece elements, each
+// queued on the worker owning that part of dest. The merges move elements
+// out of the array, so every stretch is ranked before any of them starts.
 
-	tpr = swap.begin() + right - 1;
+template<typename T, typename OutputIt, typename InputIt, typename Compare>
+void parallel_merge_level(task_pool& pool, task_pool::group& group, OutputIt dest, InputIt from, size_t nmemb, size_t block, size_t piece, Compare cmp)
+{
+	std::vector<size_t> ranks;
 
-	while (tpl > array + 16 && tpr > swap.begin() + 16)
+	for (size_t offset = 0 ; offset < nmemb ; offset += block * 2)
 	{
-	tpl_tpr16:
-		if (scandum_not_greater(cmp, *tpl, *(tpr - 15)))
-		{
-			loop = 16; do *tpa-- = scandum_move(*tpr--); while (--loop);
+		size_t lsize = std::min(block, nmemb - offset);
+		size_t rsize = std::min(block, nmemb - offset - lsize);
 
-			if (tpr > swap.begin() + 16) { goto tpl_tpr16; } break;
+		for (size_t start = 0 ; start < lsize + rsize ; start += piece)
+		{
+			ranks.push_back(merge_path_rank(from + offset, lsize, from + (offset + lsize), rsize, start, cmp));
 		}
+		ranks.push_back(lsize);
+	}
 
-	tpl16_tpr:
-		if (scandum_greater(cmp, *(tpl - 15), *tpr))
-		{
-			loop = 16; do *tpa-- = scandum_move(*tpl--); while (--loop);
+	size_t rank = 0;
 
-			if (tpl > array + 16) { goto tpl16_tpr; } break;
-		}
-	loop = 8;
-		do
+	for (size_t offset = 0 ; offset < nmemb ; offset += block * 2, rank++)
+	{
+		size_t lsize = std::min(block, nmemb - offset);
+		size_t rsize = std::min(block, nmemb - offset - lsize);
+
+		for (size_t start = 0 ; start < lsize + rsize ; start += piece, rank++)
 		{
-			if (scandum_not_greater(cmp, *tpl, *(tpr - 1)))
+			size_t end = std::min(start + piece, lsize + rsize);
+			size_t lbot = ranks[rank];
+			size_t ltop = ranks[rank + 1];
+
+			auto job = [=](size_t)
 			{
-				*tpa-- = scandum_move(*tpr--); *tpa-- = scandum_move(*tpr--);
-			}
-			else if (scandum_greater(cmp, *(tpl - 1), *tpr))
+				InputIt left = from + offset;
+
+				merge_path_merge(dest + (offset + start), left + lbot, ltop - lbot, left + (lsize + start - lbot), (end - ltop) - (start - lbot), cmp);
+			};
+
+			try
 			{
-				*tpa-- = scandum_move(*tpl--); *tpa-- = scandum_move(*tpl--);
+				pool.push(pool.owner(offset + start, nmemb), group, job);
 			}
-			else
+			catch (...)
 			{
-				x = scandum_not_greater(cmp, *tpl, *tpr);
-				tpa--;
-				tpa[x] = scandum_move(*tpr);
-				tpr -= 1;
-				tpa[!x] = scandum_move(*tpl);
-				tpl -= 1;
-				tpa--;
-				scandum_tail_branchless_merge(tpa, x, tpl, tpr, cmp);
+				job(0);
 			}
-		} while (--loop);
+		}
 	}
+	pool.wake();
+	pool.wait(0, group);
+}
 
-	while (tpr > swap.begin() + 1 && tpl > array + 1)
+// Sorts runs of the array on separate threads with quadsort_swap(), then
+// merges them in pairs, splitting every merge between the threads. A power
+// of four runs makes the merges end back in the array. Runs and pieces of
+// merges are at least grain elements long, and go to the worker owning that
+// part of the array, which is then the first to touch its swap space.
+
+template<typename T, typename Iterator, typename Compare>
+void parallel_quadsort_with(parallel_backend& backend, Iterator array, size_t nmemb, size_t threads, Compare cmp, size_t grain = QUAD_TASK)
+{
+	size_t runs = 4;
+
+	while (runs < threads && nmemb / (runs * 4) >= grain)
 	{
-	tpr2:
-		if (scandum_not_greater(cmp, *tpl, *(tpr - 1)))
-		{
-			*tpa-- = scandum_move(*tpr--); *tpa-- = scandum_move(*tpr--);
+		runs *= 4;
+	}
 
-			if (tpr > swap.begin() + 1) { goto tpr2; } break;
-		}
+	if (threads <= 1 || nmemb / runs < grain)
+	{
+		quadsort_limited<T>(array, nmemb, nmemb, cmp);
+		return;
+	}
+	stack_swap<T, quad_swap_min> stack;
+	swap_space<T> swap(nmemb, quad_swap_min, stack, array);
 
-		if (scandum_greater(cmp, *(tpl - 1), *tpr))
-		{
-			*tpa-- = scandum_move(*tpl--); *tpa-- = scandum_move(*tpl--);
+	if (swap.size() < nmemb)
+	{
+		quadsort_scratch<T>(array, swap, nmemb, cmp);
+		return;
+	}
+	task_pool pool(threads);
+	task_pool::group group;
+	size_t block = (nmemb + runs - 1) / runs;
+	size_t piece = std::max<size_t>(grain, nmemb / (threads * 4));
 
-			if (tpl > array + 1) { goto tpl2; } break;
+	pool.run(backend, [&](size_t worker)
+	{
+		if (worker != 0)
+		{
+			pool.work(worker);
+			return;
 		}
-		goto cross_swap;
 
-	tpl2:
-		if (scandum_greater(cmp, *(tpl - 1), *tpr))
+		// the tasks already handed out must finish before the swap space can
+		// be freed, even when a task run on this thread threw
+
+		try
 		{
-			*tpa-- = scandum_move(*tpl--); *tpa-- = scandum_move(*tpl--);
+			for (size_t offset = 0 ; offset < nmemb ; offset += block)
+			{
+				size_t length = std::min(block, nmemb - offset);
 
-			if (tpl > array + 1) { goto tpl2; } break;
-		}
+				auto job = [=, &swap](size_t)
+				{
+					swap_space<T> part(swap, offset, length);
 
-		if (scandum_not_greater(cmp, *tpl, *(tpr - 1)))
-		{
-			*tpa-- = scandum_move(*tpr--); *tpa-- = scandum_move(*tpr--);
+					quadsort_swap<T>(array + offset, part, length, cmp);
+				};
 
-			if (tpr > swap.begin() + 1) { goto tpr2; } break;
-		}
-	cross_swap:
+				try
+				{
+					pool.push(pool.owner(offset, nmemb), group, job);
+				}
+				catch (...)
+				{
+					job(0);
+				}
+			}
+			pool.wake();
+			pool.wait(0, group);
 
-		x = scandum_not_greater(cmp, *tpl, *tpr);
-		tpa--;
-		tpa[x] = scandum_move(*tpr);
-		tpr -= 1;
-		tpa[!x] = scandum_move(*tpl);
-		tpl -= 1;
-		tpa--;
-		scandum_tail_branchless_merge(tpa, x, tpl, tpr, cmp);
-	}
+			while (block < nmemb && !pool.failed())
+			{
+				parallel_merge_level<T>(pool, group, swap.begin(), array, nmemb, block, piece, cmp);
 
-	// TODO: this logic is really ugly and branchy and can probably be simplified
-	while (tpr >= swap.begin() && tpl >= array) {
-		if (scandum_greater(cmp, *tpl, *tpr)) {
-			*tpa = scandum_move((T&)*tpl); --tpa;
-			if (tpl > array) { --tpl; } else break;
-		} else {
-			*tpa = scandum_move((T&)*tpr);
-			if (tpr > swap.begin()) { --tpr; --tpa; } else return;
-		}
-	}
+				block *= 2;
 
-	if (tpr >= swap.begin()) {
-		*tpa = scandum_move(*tpr);
-		while (tpr > swap.begin())
+				parallel_merge_level<T>(pool, group, array, swap.begin(), nmemb, block, piece, cmp);
+
+				block *= 2;
+			}
+		}
+		catch (...)
 		{
-			*--tpa = scandum_move(*--tpr);
+			pool.wait(0, group);
+			throw;
 		}
-	}
+	});
 }
 
-// the next four functions provide in-place rotate merge support
+} // namespace scandum::detail
 
-template<typename T, typename Iterator>
-void trinity_rotation(Iterator array, swap_space<T>& swap, size_t nmemb, size_t left)
+// Sorts without allocating for fewer than 32 elements, when 32 elements fit in
+// QUAD_STACK bytes, and can't throw when moving and comparing elements can't
+
+template<typename Iterator, typename Compare>
+void quadsort(Iterator begin, Iterator end, Compare cmp) noexcept(detail::is_nothrow_sortable_v<typename std::iterator_traits<Iterator>::value_type, Compare, detail::quad_swap_min>)
 {
-	temp_var<T> temp;
-	size_t bridge, right = nmemb - left;
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
 
-	size_t swap_size = swap.size() < 65536 ? swap.size() : 65536;
+	typedef std::remove_reference_t<decltype(*begin)> T;
 
-	if (left < right)
+	size_t nmemb = std::distance(begin, end);
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
 	{
-		if (left <= swap_size)
-		{
-			scandum_copy_range(T, swap.begin(), array, left);
-			scandum_copy_overlapping_range(T, array, array + left, right);
-			scandum_copy_range(T, array + right, swap.begin(), left);
-		}
-		else
-		{
-			Iterator pta, ptb, ptc, ptd;
+		detail::quadsort_limited<T>(array, nmemb, std::numeric_limits<size_t>::max(), cmp);
+	});
+}
 
-			pta = array;
-			ptb = pta + left;
+// A limit on the scratch memory a sort may use, in bytes, and the most it
+// used, as reported back by the sort
 
-			bridge = right - left;
+struct scratch_budget {
+	size_t limit = std::numeric_limits<size_t>::max();
+	size_t peak = 0;
+};
 
-			if (bridge <= swap_size && bridge > 3)
-			{
-				ptc = pta + right;
-				ptd = ptc + left;
+// Sorts within a scratch memory budget. Any budget works, down to none at
+// all, but the sort always uses the 32 elements of swap space quad_swap()
+// needs, on the stack where it fits. The less memory beyond that, the more
+// the merges lean on rotations; the sort stays stable either way.
 
-				scandum_copy_range(T, swap.begin(), ptb, bridge);
+template<typename Iterator, typename Compare>
+void quadsort(Iterator begin, Iterator end, Compare cmp, scratch_budget& budget) noexcept(detail::is_nothrow_sortable_v<typename std::iterator_traits<Iterator>::value_type, Compare, detail::quad_swap_min>)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
 
-				while (left--)
-				{
-					*--ptc = scandum_move(*--ptd); *ptd = scandum_move(*--ptb);
-				}
-				scandum_copy_range(T, pta, swap.begin(), bridge);
-			}
-			else
-			{
-				ptc = ptb;
-				ptd = ptc + right;
+	typedef std::remove_reference_t<decltype(*begin)> T;
 
-				bridge = left / 2;
+	size_t nmemb = std::distance(begin, end);
 
-				while (bridge--)
-				{
-					temp = scandum_move(*--ptb);
-					*ptb = scandum_move(*pta);
-					*pta++ = scandum_move(*ptc);
-					*ptc++ = scandum_move(*--ptd);
-					*ptd = scandum_move(temp);
-				}
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		budget.peak = detail::quadsort_limited<T>(array, nmemb, budget.limit / sizeof(T), cmp) * sizeof(T);
+	});
+}
 
-				bridge = (ptd - ptc) / 2;
+// The number of bytes of scratch memory quadsort() uses for nmemb elements of type T
 
-				while (bridge--)
-				{
-					temp = scandum_move(*ptc);
-					*ptc++ = scandum_move(*--ptd);
-					*ptd = scandum_move(*pta);
-					*pta++ = scandum_move(temp);
-				}
+template<typename T>
+size_t quadsort_scratch_size(size_t nmemb)
+{
+	return detail::swap_space_bytes<T>(detail::quad_swap_size(nmemb));
+}
 
-				bridge = (ptd - pta) / 2;
+// Sorts using caller supplied scratch memory instead of allocating. The
+// storage may be uninitialized and unaligned; quadsort_scratch_size() bytes
+// give full speed, less makes the sort lean on the in-place rotation merges.
+// Only storage too small to hold 32 elements makes the sort fall back on the
+// stack, or allocate for types too large for that.
 
-				while (bridge--)
-				{
-					temp = scandum_move(*pta);
-					*pta++ = scandum_move(*--ptd);
-					*ptd = scandum_move(temp);
-				}
-			}
-		}
-	}
-	else if (right < left)
+template<typename Iterator, typename Compare>
+void quadsort(Iterator begin, Iterator end, Compare cmp, void* scratch, size_t scratch_size) noexcept(detail::is_nothrow_sortable_v<typename std::iterator_traits<Iterator>::value_type, Compare, detail::quad_swap_min>)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
+
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = std::distance(begin, end);
+
+	detail::swap_space<T> swap(scratch, scratch_size, detail::quad_swap_size(nmemb), begin);
+
+	if (swap.size() < std::min(nmemb, detail::quad_swap_min))
 	{
-		if (right <= swap_size)
-		{
-			scandum_copy_range(T, swap.begin(), array + left, right);
-			scandum_copy_overlapping_range(T, array + right, array, left);
-			scandum_copy_range(T, array, swap.begin(), right);
-		}
-		else
+		detail::stack_swap<T, detail::quad_swap_min> stack;
+		detail::swap_space<T> fallback(std::min(nmemb, detail::quad_swap_min), std::min(nmemb, detail::quad_swap_min), stack, begin);
+
+		detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
 		{
-			Iterator pta, ptb, ptc, ptd;
+			detail::quadsort_scratch<T>(array, fallback, nmemb, cmp);
+		});
+		return;
+	}
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::quadsort_scratch<T>(array, swap, nmemb, cmp);
+	});
+}
 
-			pta = array;
-			ptb = pta + left;
+// Lets sorts on the calling thread keep their scratch memory between calls,
+// up to bytes of it, instead of allocating it each time. A limit of zero, the
+// default, turns the arena off and frees it.
+
+inline void set_scratch_arena_limit(size_t bytes)
+{
+	detail::thread_arena.set_limit(bytes);
+}
+
+// The number of bytes the calling thread's arena currently holds
+
+inline size_t scratch_arena_size()
+{
+	return detail::thread_arena.size();
+}
 
-			bridge = left - right;
+// Frees the calling thread's arena if it holds more than bytes. It regrows on
+// demand. Has no effect while a sort on the calling thread is using it.
 
-			if (bridge <= swap_size && bridge > 3)
-			{
-				ptc = pta + right;
-				ptd = ptc + left;
+inline void trim_scratch_arena(size_t bytes = 0)
+{
+	detail::thread_arena.trim(bytes);
+}
 
-				scandum_copy_range(T, swap.begin(), ptc, bridge);
+// Switches NUMA placement of the parallel sorts on or off, and tells whether
+// it is on. It is on by default when built with SCANDUM_NUMA on a system with
+// more than one node, and can't be switched on otherwise.
 
-				while (right--)
-				{
-					*ptc++ = scandum_move(*pta); *pta++ = scandum_move(*ptb++);
-				}
-				scandum_copy_range(T, ptd - bridge, swap.begin(), bridge);
-			}
-			else
-			{
-				ptc = ptb;
-				ptd = ptc + right;
+inline bool set_numa_placement(bool enabled)
+{
+#ifdef SCANDUM_NUMA
+	enabled = enabled && numa_available() >= 0 && numa_num_configured_nodes() > 1;
+#else
+	enabled = false;
+#endif
+	detail::numa_enabled.store(enabled);
 
-				bridge = right / 2;
+	return enabled;
+}
 
-				while (bridge--)
-				{
-					temp = scandum_move(*--ptb);
-					*ptb = scandum_move(*pta);
-					*pta++ = scandum_move(*ptc);
-					*ptc++ = scandum_move(*--ptd);
-					*ptd = scandum_move(temp);
-				}
+inline bool numa_placement()
+{
+	return detail::numa_enabled.load();
+}
 
-				bridge = (ptb - pta) / 2;
+// Caps the instruction set of the kernels for primitive keys at isa, to
+// compare them on one machine, and tells which one the sorts started from
+// now on use: the lesser of isa and the widest the processor supports. It is
+// always simd_isa::scalar when built with SCANDUM_NO_SIMD or for another
+// architecture.
 
-				while (bridge--)
-				{
-					temp = scandum_move(*--ptb);
-					*ptb = scandum_move(*pta);
-					*pta++ = scandum_move(*--ptd);
-					*ptd = scandum_move(temp);
-				}
+inline simd_isa set_simd_isa(simd_isa isa)
+{
+#ifdef SCANDUM_SIMD
+	detail::simd_isa_limit.store(isa);
 
-				bridge = (ptd - pta) / 2;
+	return detail::cpu_simd_isa();
+#else
+	(void) isa;
 
-				while (bridge--)
-				{
-					temp = scandum_move(*pta);
-					*pta++ = scandum_move(*--ptd);
-					*ptd = scandum_move(temp);
-				}
-			}
-		}
-	}
-	else
-	{
-		Iterator pta, ptb;
+	return simd_isa::scalar;
+#endif
+}
 
-		pta = array;
-		ptb = pta + left;
+inline simd_isa current_simd_isa()
+{
+#ifdef SCANDUM_SIMD
+	return detail::cpu_simd_isa();
+#else
+	return simd_isa::scalar;
+#endif
+}
 
-		while (left--)
-		{
-			temp = scandum_move(*pta);
-			*pta++ = scandum_move(*ptb);
-			*ptb++ = scandum_move(temp);
-		}
-	}
+// Makes the parallel sorts run on backend, which must outlive them, instead
+// of starting threads of their own. A null backend restores the built-in one.
+
+inline void set_parallel_backend(parallel_backend* backend)
+{
+	detail::current_backend.store(backend);
 }
 
-template<typename T, typename Iterator, typename Compare>
-size_t monobound_binary_first(Iterator array, Iterator value, size_t top, Compare cmp)
+inline parallel_backend& get_parallel_backend()
 {
-	size_t mid;
-	Iterator end = array + top;
+	parallel_backend* backend = detail::current_backend.load();
 
-	while (top > 1)
+	return backend ? *backend : detail::default_backend;
+}
+
+// The parallel sorts also take an executor, a type with
+//
+//   typename task_group;                                // default constructible
+//   size_t concurrency() const;                         // how many tasks run at once
+//   void submit(task_group&, std::function<void()>);    // runs a task, now or later
+//   void wait(task_group&);                             // returns once a group's tasks have
+//
+// and start no threads of their own when given one. Tasks never throw.
+
+// An executor with a fixed set of threads, started on construction, which
+// also runs tasks on whichever thread waits on a group. It must outlive the
+// tasks submitted to it. With NUMA placement the threads are spread evenly
+// over the nodes.
+
+class thread_executor {
+public:
+	using task_group = detail::task_pool::group;
+
+	// threads is the concurrency, counting the thread that waits, so one
+	// thread fewer is started; 0 stands for every hardware thread
+
+	explicit thread_executor(size_t threads = 0) : pool(threads ? threads : std::max<unsigned>(std::thread::hardware_concurrency(), 1))
 	{
-		mid = top / 2;
+		size_t nodes = detail::numa_nodes();
 
-		if (scandum_not_greater(cmp, *value, *(end - mid)))
+		try
 		{
-			end -= mid;
+			for (size_t worker = 1 ; worker < pool.size() ; worker++)
+			{
+				workers.emplace_back([this, worker, nodes]
+				{
+					if (nodes > 1)
+					{
+						detail::numa_bind(worker * nodes / pool.size());
+					}
+					pool.locate(worker);
+					pool.work(worker);
+				});
+			}
+		}
+		catch (...)
+		{
+			join();
+			throw;
 		}
-		top -= mid;
 	}
 
-	if (scandum_not_greater(cmp, *value, *(end - 1)))
+	thread_executor(const thread_executor&) = delete;
+	thread_executor& operator=(const thread_executor&) = delete;
+
+	~thread_executor()
 	{
-		end--;
+		join();
 	}
-	return (end - array);
-}
-
-template<typename T, typename Iterator, typename Compare>
-void rotate_merge_block(Iterator array, swap_space<T>& swap, size_t lblock, size_t right, Compare cmp)
-{
-	size_t left, rblock, unbalanced;
 
-	if (scandum_not_greater(cmp, *(array + lblock - 1), *(array + lblock)))
+	size_t concurrency() const
 	{
-		return;
+		return pool.size();
 	}
 
-	rblock = lblock / 2;
-	lblock -= rblock;
-
-	left = monobound_binary_first<T>(array + lblock + rblock, array + lblock, right, cmp);
-
-	right -= left;
+	void submit(task_group& group, std::function<void()> task)
+	{
+		pool.push(0, group, [task = std::move(task)](size_t) { task(); });
+	}
 
-	// [ lblock ] [ rblock ] [ left ] [ right ]
+	void wait(task_group& group)
+	{
+		pool.wait(0, group);
+	}
 
-	if (left)
+private:
+	void join()
 	{
-		if (lblock + left <= swap.size())
-		{
-			scandum_copy_range(T, swap.begin(), array, lblock);
-			scandum_copy_range(T, swap.begin() + lblock, array + lblock + rblock, left);
-			scandum_copy_overlapping_range(T, array + lblock + left, array + lblock, rblock);
+		pool.stop();
 
-			cross_merge<T>(array, swap.begin(), lblock, left, cmp);
-		}
-		else
+		for (std::thread& worker : workers)
 		{
-			trinity_rotation<T>(array + lblock, swap, rblock + left, rblock);
-
-			unbalanced = (left * 2 < lblock) | (lblock * 2 < left);
-
-			if (unbalanced && left <= swap.size())
-			{
-				partial_backward_merge<T>(array, swap, lblock + left, lblock, cmp);
-			}
-			else if (unbalanced && lblock <= swap.size())
-			{
-				partial_forward_merge<T>(array, swap, lblock + left, lblock, cmp);
-			}
-			else
-			{
-				rotate_merge_block<T>(array, swap, lblock, left, cmp);
-			}
+			worker.join();
 		}
 	}
 
-	if (right)
+	detail::task_pool pool;
+	std::vector<std::thread> workers;
+};
+
+// An executor that runs every task on submission, on the calling thread. The
+// parallel sorts sort serially on it.
+
+class inline_executor {
+public:
+	struct task_group {};
+
+	size_t concurrency() const
 	{
-		unbalanced = (right * 2 < rblock) | (rblock * 2 < right);
+		return 1;
+	}
 
-		if ((unbalanced && right <= swap.size()) || right + rblock <= swap.size())
-		{
-			partial_backward_merge<T>(array + lblock + left, swap, rblock + right, rblock, cmp);
-		}
-		else if (unbalanced && rblock <= swap.size())
-		{
-			partial_forward_merge<T>(array + lblock + left, swap, rblock + right, rblock, cmp);
-		}
-		else
-		{
-			rotate_merge_block<T>(array + lblock + left, swap, rblock, right, cmp);
-		}
+	void submit(task_group&, const std::function<void()>& task)
+	{
+		task();
 	}
-}
 
-template<typename T, typename Iterator, typename Compare>
-void rotate_merge(Iterator array, swap_space<T>& swap, size_t nmemb, size_t block, Compare cmp)
-{
-	Iterator pta, pte;
+	void wait(task_group&) {}
+};
 
-	pte = array + nmemb;
+// Runs the parallel sorts on an executor, and can be passed to
+// set_parallel_backend() to make that the default. Each worker but the first
+// is submitted as a task; one that the executor runs on the calling thread
+// is skipped, as that thread is already worker 0.
 
-	if (nmemb <= block * 2 && nmemb - block <= swap.size())
-	{
-		partial_backward_merge<T>(array, swap, nmemb, block, cmp);
+template<typename Executor>
+class executor_backend : public parallel_backend {
+public:
+	explicit executor_backend(Executor& executor) : executor(executor) {}
 
-		return;
+	size_t concurrency() const override
+	{
+		return executor.concurrency();
 	}
 
-	while (block < nmemb)
+	void run(size_t workers, const std::function<void(size_t)>& body) override
 	{
-		for (pta = array ; pta + block < pte ; pta += block * 2)
+		typename Executor::task_group group;
+		std::thread::id caller = std::this_thread::get_id();
+
+		try
 		{
-			if (pta + block * 2 < pte)
+			for (size_t worker = 1 ; worker < workers ; worker++)
 			{
-				rotate_merge_block<T>(pta, swap, block, block, cmp);
-
-				continue;
+				executor.submit(group, [&body, caller, worker]
+				{
+					if (std::this_thread::get_id() != caller)
+					{
+						body(worker);
+					}
+				});
 			}
-			rotate_merge_block<T>(pta, swap, block, pte - pta - block, cmp);
-
-			break;
 		}
-		block *= 2;
+		catch (...) {}
+
+		body(0);
+
+		executor.wait(group);
 	}
-}
 
-template<typename T, typename Iterator, typename Compare>
-void quadsort_swap(Iterator array, swap_space<T>& swap, size_t nmemb, Compare cmp)
+private:
+	Executor& executor;
+};
+
+// Sorts with scratch memory from alloc, which may be any allocator, instead of
+// the heap or the thread's arena. Small sorts still keep it on the stack.
+
+template<typename Iterator, typename Compare, typename Alloc, std::enable_if_t<detail::is_allocator_v<Alloc>, int> = 0>
+void quadsort(Iterator begin, Iterator end, Compare cmp, const Alloc& alloc)
 {
-	Iterator pta = array;
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
 
-	if (nmemb <= 96)
-	{
-		tail_swap<T>(pta, swap, nmemb, cmp);
-	}
-	else if (quad_swap<T>(pta, nmemb, cmp) == 0)
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	size_t nmemb = std::distance(begin, end);
+	detail::scratch_allocator source = detail::make_scratch_allocator(alloc);
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
 	{
-		size_t block = quad_merge<T>(pta, swap, nmemb, 32, cmp);
+		detail::quadsort_limited<T>(array, nmemb, std::numeric_limits<size_t>::max(), cmp, &source);
+	});
+}
 
-		rotate_merge<T>(pta, swap, nmemb, block, cmp);
-	}
+#ifdef __cpp_lib_memory_resource
+template<typename Iterator, typename Compare>
+void quadsort(Iterator begin, Iterator end, Compare cmp, std::pmr::memory_resource* resource)
+{
+	quadsort(begin, end, cmp, std::pmr::polymorphic_allocator<unsigned char>(resource));
 }
+#endif
 
-} // namespace scandum::detail
+// Sorts on up to threads threads, or on every hardware thread when threads is
+// 0, with the same stable result as quadsort(). Arrays of fewer than four
+// runs of QUAD_TASK elements are sorted on the calling thread alone. Unlike
+// quadsort(), it uses scratch memory for the whole array, and falls back on
+// sorting on one thread with what it can get when that can't be allocated.
+// Comparisons run concurrently, and an exception from any of them is
+// rethrown once all threads are done, leaving the array in a valid but
+// unspecified state.
 
 template<typename Iterator, typename Compare>
-void quadsort(Iterator begin, Iterator end, Compare cmp)
+void parallel_quadsort(Iterator begin, Iterator end, Compare cmp, size_t threads = 0)
 {
 	static_assert (
 #if __cplusplus >= 202002L
@@ -1333,42 +4039,90 @@ void quadsort(Iterator begin, Iterator end, Compare cmp)
 
 	typedef std::remove_reference_t<decltype(*begin)> T;
 
-	size_t nmemb = std::distance(begin, end);
-	Iterator pta = begin;
+	size_t nmemb = static_cast<size_t>(end - begin);
 
-	if (nmemb < 32)
-	{
-		detail::swap_space<T> swap(nmemb);
+	parallel_backend& backend = get_parallel_backend();
 
-		detail::tail_swap<T>(pta, swap, nmemb, cmp);
-	}
-	else if (detail::quad_swap<T>(pta, nmemb, cmp) == 0)
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
 	{
-		size_t block, swap_size = nmemb;
+		detail::parallel_quadsort_with<T>(backend, array, nmemb, threads ? threads : backend.concurrency(), cmp);
+	});
+}
+
+// parallel_quadsort() on executor, with runs and pieces of merges of at
+// least grain elements. Arrays of fewer than four runs are sorted on the
+// calling thread without submitting anything.
+
+template<typename Executor, typename Iterator, typename Compare, std::enable_if_t<detail::is_executor_v<Executor>, int> = 0>
+void parallel_quadsort(Executor& executor, Iterator begin, Iterator end, Compare cmp, size_t grain = QUAD_TASK)
+{
+	static_assert (
+#if __cplusplus >= 202002L
+		std::random_access_iterator<Iterator>,
+#else
+		std::is_convertible_v<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>,
+#endif
+		"type 'Iterator' must be a random access iterator"
+	);
 
-		if (nmemb > 4194304) for (swap_size = 4194304 ; swap_size * 8 <= nmemb ; swap_size *= 4) {}
+	assert(grain > 0);
 
-		detail::swap_space<T> swap(swap_size);
+	typedef std::remove_reference_t<decltype(*begin)> T;
 
-		block = detail::quad_merge<T>(pta, swap, nmemb, 32, cmp);
+	size_t nmemb = static_cast<size_t>(end - begin);
 
-		detail::rotate_merge<T>(pta, swap, nmemb, block, cmp);
-	}
+	executor_backend<Executor> backend(executor);
+
+	detail::with_known_compare<T>(begin, nmemb, cmp, [&](auto array, auto cmp)
+	{
+		detail::parallel_quadsort_with<T>(backend, array, nmemb, executor.concurrency(), cmp, grain);
+	});
+}
+
+template<typename Executor, typename Iterator, std::enable_if_t<detail::is_executor_v<Executor>, int> = 0>
+void parallel_quadsort(Executor& executor, Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return parallel_quadsort(executor, begin, end, std::less<T>());
+}
+
+template<typename Iterator>
+void parallel_quadsort(Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+	return parallel_quadsort(begin, end, std::less<T>());
 }
 
 template<typename Iterator>
-void quadsort(Iterator begin, Iterator end)
+void quadsort(Iterator begin, Iterator end) noexcept(noexcept(quadsort(begin, end, std::less<typename std::iterator_traits<Iterator>::value_type>())))
 {
 	typedef std::remove_reference_t<decltype(*begin)> T;
 	return quadsort(begin, end, std::less<T>());
 }
 
+// Sorts integers and floating point numbers in ascending order, like the C
+// quadsort_prim(), with the thresholds tuned for primitive keys picked at compile
+// time rather than with a cmp macro for the whole translation unit. NaNs
+// leave the order unspecified, as they do with std::less.
+
+template<typename Iterator>
+void quadsort_prim(Iterator begin, Iterator end) noexcept(noexcept(quadsort(begin, end, detail::prim_less<typename std::iterator_traits<Iterator>::value_type>())))
+{
+	typedef typename std::iterator_traits<Iterator>::value_type T;
+
+	static_assert(std::is_arithmetic_v<T>, "quadsort_prim() sorts integral and floating point types only");
+
+	quadsort(begin, end, detail::prim_less<T>());
+}
+
 } // namespace scandum
 
 #undef scandum_greater
 #undef scandum_not_greater
 #undef scandum_branchless_swap
+#undef scandum_generic_branchless_swap
 #undef scandum_swap_branchless
+#undef scandum_swap_pair
 #undef scandum_move
 #undef scandum_head_branchless_merge
 #undef scandum_tail_branchless_merge
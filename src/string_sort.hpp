@@ -0,0 +1,305 @@
+#ifndef SCANDUM_STRING_SORT_HPP
+#define SCANDUM_STRING_SORT_HPP
+
+// string_sort() sorts std::string, std::string_view and C strings in the
+// order of their bytes taken as unsigned chars, which is that of std::less on
+// std::string and of strcmp(). The first 8 bytes of each string are packed
+// into a big-endian integer and sorted with the index of their string, so
+// that most comparisons are of integers. Strings that share those bytes are
+// sorted by multikey quicksort on the next 8, and so on, with the bytes
+// cached beside the index, so that the prefix shared by a bucket of strings
+// is never compared again. Small buckets are sorted with quadsort, comparing
+// strings past that prefix only. Equal strings may be reordered.
+
+#include <algorithm>   // for std::min
+#include <cstdint>
+#include <cstring>     // for std::memcpy and std::strcmp
+#include <memory>
+#include <new>         // for std::nothrow
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "crumsort.hpp"
+#include "projection.hpp"
+
+// Arrays of up to this many strings are sorted by comparing them in full
+
+#ifndef STRING_SORT_MIN
+#define STRING_SORT_MIN 64
+#endif
+
+// Buckets of up to this many strings sharing a prefix are sorted with
+// quadsort rather than partitioned further
+
+#ifndef STRING_SORT_OUT
+#define STRING_SORT_OUT 32
+#endif
+
+namespace scandum {
+
+namespace detail {
+
+template<typename T>
+constexpr bool is_c_string_v = std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+template<typename T>
+constexpr bool is_string_key_v = is_c_string_v<T> || std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+// compares two strings like strcmp(), from offset on, which both must reach
+// when they are C strings
+
+template<typename T>
+int compare_strings(const T& lhs, const T& rhs, size_t offset = 0) noexcept
+{
+	if constexpr (is_c_string_v<T>)
+	{
+		return std::strcmp(lhs + offset, rhs + offset);
+	}
+	else
+	{
+		std::string_view left(lhs), right(rhs);
+
+		offset = std::min(offset, std::min(left.size(), right.size()));
+
+		return left.substr(offset).compare(right.substr(offset));
+	}
+}
+
+inline std::uint64_t load_big_endian(const unsigned char* bytes) noexcept
+{
+	std::uint64_t prefix = 0;
+
+	for (size_t cnt = 0 ; cnt < 8 ; cnt++)
+	{
+		prefix = prefix << 8 | bytes[cnt];
+	}
+	return prefix;
+}
+
+// the 8 bytes of a string from offset on, which C strings must reach, as a
+// big-endian integer, padded with zeros, which orders strings by those bytes
+// like compare_strings() does
+
+template<typename T>
+std::uint64_t string_prefix(const T& str, size_t offset = 0) noexcept
+{
+	unsigned char bytes[8] = {};
+
+	if constexpr (is_c_string_v<T>)
+	{
+		for (size_t cnt = 0 ; cnt < 8 && str[offset + cnt] ; cnt++)
+		{
+			bytes[cnt] = static_cast<unsigned char>(str[offset + cnt]);
+		}
+	}
+	else if (offset < str.size())
+	{
+		std::memcpy(bytes, str.data() + offset, std::min<size_t>(str.size() - offset, 8));
+	}
+	return load_big_endian(bytes);
+}
+
+// a prefix and the index of its string, sorted by the prefix alone
+
+struct string_key {
+	std::uint64_t prefix;
+	std::uint64_t index;
+};
+
+struct string_key_less {
+	bool operator()(const string_key& lhs, const string_key& rhs) const noexcept
+	{
+		return lhs.prefix < rhs.prefix;
+	}
+};
+
+// Compares the strings of two keys holding their 8 bytes from depth on, which
+// all strings of the bucket share up to, by those bytes and then by the rest
+// of the strings. C strings that end within those bytes are equal.
+
+template<typename T, typename Iterator>
+struct string_key_compare {
+	int operator()(const string_key& lhs, const string_key& rhs) const noexcept
+	{
+		if (lhs.prefix != rhs.prefix)
+		{
+			return lhs.prefix < rhs.prefix ? -1 : 1;
+		}
+		if (is_c_string_v<T> && (lhs.prefix & 0xff) == 0)
+		{
+			return 0;
+		}
+		return compare_strings(array[lhs.index], array[rhs.index], depth + 8);
+	}
+
+	Iterator array;
+	size_t depth;
+};
+
+template<typename T, typename Iterator>
+using string_key_less_at = three_way_less<string_key_compare<T, Iterator>>;
+
+// the number of uneven splits multikey_sort() allows at one depth, twice the
+// binary logarithm of the size of the bucket
+
+inline size_t multikey_limit(size_t nmemb) noexcept
+{
+	size_t limit = 0;
+
+	for ( ; nmemb > 1 ; nmemb /= 2) limit += 2;
+
+	return limit;
+}
+
+inline std::uint64_t median_of_three(std::uint64_t a, std::uint64_t b, std::uint64_t c) noexcept
+{
+	return a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b);
+}
+
+// Moves a bucket of keys that share their 8 bytes from depth on to the next
+// 8 bytes, returning false when there are none, as the strings end within
+// those bytes. The bucket is then sorted by the length of its strings, with
+// the whole comparison, or left as it is for C strings, which are equal.
+
+template<typename T, typename Iterator>
+bool next_depth(Iterator array, swap_space<string_key>& swap, string_key* keys, size_t nmemb, size_t& depth)
+{
+	if ((keys[0].prefix & 0xff) == 0)
+	{
+		if (!is_c_string_v<T>)
+		{
+			crumsort_swap<string_key>(keys, swap, nmemb, string_key_less_at<T, Iterator> { { array, depth } });
+		}
+		return false;
+	}
+	depth += 8;
+
+	for (size_t cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		keys[cnt].prefix = string_prefix(array[keys[cnt].index], depth);
+	}
+	return true;
+}
+
+// Sorts a bucket of keys, holding the 8 bytes of their strings from depth on,
+// by multikey quicksort: the keys are split three ways around the median of
+// three of those bytes, the lesser and greater keys are sorted at the same
+// depth, and the equal ones at the next. Buckets of up to STRING_SORT_OUT
+// keys are sorted with quadsort_swap(), and any left after limit uneven
+// splits at one depth with crumsort_swap().
+
+template<typename T, typename Iterator>
+void multikey_sort(Iterator array, swap_space<string_key>& swap, string_key* keys, size_t nmemb, size_t depth, size_t limit)
+{
+	while (nmemb > STRING_SORT_OUT)
+	{
+		if (limit == 0)
+		{
+			crumsort_swap<string_key>(keys, swap, nmemb, string_key_less_at<T, Iterator> { { array, depth } });
+			return;
+		}
+		std::uint64_t piv = median_of_three(keys[0].prefix, keys[nmemb / 2].prefix, keys[nmemb - 1].prefix);
+		size_t lt = 0, gt = nmemb;
+
+		for (size_t cnt = 0 ; cnt < gt ; )
+		{
+			if (keys[cnt].prefix < piv)
+			{
+				std::swap(keys[lt++], keys[cnt++]);
+			}
+			else if (keys[cnt].prefix > piv)
+			{
+				std::swap(keys[cnt], keys[--gt]);
+			}
+			else
+			{
+				cnt++;
+			}
+		}
+		size_t uneven = lt > nmemb / 2 || nmemb - gt > nmemb / 2;
+
+		multikey_sort<T>(array, swap, keys, lt, depth, limit - uneven);
+		multikey_sort<T>(array, swap, keys + gt, nmemb - gt, depth, limit - uneven);
+
+		keys += lt;
+		nmemb = gt - lt;
+
+		if (!next_depth<T>(array, swap, keys, nmemb, depth))
+		{
+			return;
+		}
+		limit = multikey_limit(nmemb);
+	}
+
+	if (nmemb > 1)
+	{
+		quadsort_swap<string_key>(keys, swap, nmemb, string_key_less_at<T, Iterator> { { array, depth } });
+	}
+}
+
+// Sorts the strings by their prefixes, then the runs of strings that share a
+// prefix with multikey_sort(), and moves the strings into place, returning
+// false when there is no memory for the prefixes. Sorting the first 8 bytes
+// with crumsort was found to be faster than partitioning them, as most of
+// them differ.
+
+template<typename T, typename Iterator>
+bool sort_prefixes(Iterator array, size_t nmemb)
+{
+	std::unique_ptr<string_key[]> keys(new (std::nothrow) string_key[nmemb]);
+
+	if (!keys)
+	{
+		return false;
+	}
+
+	for (size_t cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		keys[cnt] = { string_prefix(array[cnt]), cnt };
+	}
+	crumsort(keys.get(), keys.get() + nmemb, string_key_less());
+
+	stack_swap<string_key, 256> stack;
+	swap_space<string_key> swap(512, CRUM_OUT, stack, keys.get());
+
+	for (size_t run = 0, end ; run < nmemb ; run = end)
+	{
+		size_t depth = 0;
+
+		for (end = run + 1 ; end < nmemb && keys[end].prefix == keys[run].prefix ; end++);
+
+		if (end - run > 1 && next_depth<T>(array, swap, keys.get() + run, end - run, depth))
+		{
+			multikey_sort<T>(array, swap, keys.get() + run, end - run, depth, multikey_limit(end - run));
+		}
+	}
+	permute<T>(array, nmemb, [&](size_t cnt) -> std::uint64_t& { return keys[cnt].index; });
+
+	return true;
+}
+
+} // namespace scandum::detail
+
+// Sorts strings in the order of their bytes, comparing the first 8 bytes of
+// each as integers
+
+template<typename Iterator>
+void string_sort(Iterator begin, Iterator end)
+{
+	typedef std::remove_reference_t<decltype(*begin)> T;
+
+	static_assert(detail::is_string_key_v<std::remove_cv_t<T>>, "string_sort() sorts std::string, std::string_view and C strings only");
+
+	size_t nmemb = static_cast<size_t>(end - begin);
+
+	if (nmemb > STRING_SORT_MIN && detail::sort_prefixes<T>(begin, nmemb))
+	{
+		return;
+	}
+	crumsort(begin, end, [](const T& lhs, const T& rhs) { return detail::compare_strings(lhs, rhs); });
+}
+
+} // namespace scandum
+
+#endif
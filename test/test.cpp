@@ -2,11 +2,23 @@
 #include <doctest/doctest.h>
 
 #include <crumsort.hpp>
+#include <execution_policy.hpp>
+#include <huge_page_allocator.hpp>
+#include <projection.hpp>
 #include <quadsort.hpp>
+#include <string_sort.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <deque>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <vector>
 
 int RandomInt(int max_value = 1000) {
@@ -84,6 +96,193 @@ TEST_CASE("quadsort is stable") {
 	}));
 }
 
+//////
+// Three-way comparison
+//////
+
+TEST_CASE("crumsort and quadsort sort with a three-way comparison in fewer calls") {
+	std::vector<OrderedInt> list;
+	for (int i = 0; i < 10000; ++i) list.push_back({ RandomInt(100), i });
+
+	size_t less_calls = 0, three_way_calls = 0;
+	auto less = [&](const OrderedInt& a, const OrderedInt& b) { ++less_calls; return a.value < b.value; };
+	auto three_way = [&](const OrderedInt& a, const OrderedInt& b) { ++three_way_calls; return (a.value > b.value) - (a.value < b.value); };
+
+	std::vector<OrderedInt> crum_less = list, crum_three_way = list;
+	scandum::crumsort(crum_less.begin(), crum_less.end(), less);
+	scandum::crumsort(crum_three_way.begin(), crum_three_way.end(), three_way);
+
+	CHECK(std::is_sorted(crum_three_way.begin(), crum_three_way.end()));
+	CHECK(three_way_calls < less_calls);
+
+	less_calls = three_way_calls = 0;
+
+	std::vector<OrderedInt> quad_less = list, quad_three_way = list;
+	scandum::quadsort(quad_less.begin(), quad_less.end(), less);
+	scandum::quadsort(quad_three_way.begin(), quad_three_way.end(), three_way);
+
+	CHECK(three_way_calls < less_calls);
+
+	for (size_t i = 0; i < list.size(); ++i) CHECK(quad_three_way[i].order == quad_less[i].order);
+}
+
+#if __cplusplus >= 202002L
+TEST_CASE("crumsort and quadsort sort with std::strong_ordering and std::weak_ordering") {
+	std::vector<int> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(RandomInt());
+
+	std::vector<int> strong = list, weak = list;
+	scandum::crumsort(strong.begin(), strong.end(), [](int a, int b) { return b <=> a; });
+	scandum::quadsort(weak.begin(), weak.end(), [](int a, int b) { return std::weak_ordering(a <=> b); });
+
+	CHECK(std::is_sorted(strong.begin(), strong.end(), std::greater<int>()));
+	CHECK(std::is_sorted(weak.begin(), weak.end()));
+}
+#endif
+
+//////
+// Projection
+//////
+
+template<typename Key>
+struct Record {
+	Key key;
+	int order;
+	long long payload[2];
+};
+
+template<typename Key>
+void CheckProjectedSorts(int size, int distinct) {
+	std::vector<Record<Key>> records;
+	for (int i = 0; i < size; ++i) records.push_back({ static_cast<Key>(RandomInt(distinct) - distinct / 2), i, { i, -i } });
+
+	auto by_key = [](const Record<Key>& a, const Record<Key>& b) { return a.key < b.key; };
+	auto by_key_descending = [](const Record<Key>& a, const Record<Key>& b) { return a.key > b.key; };
+
+	std::vector<Record<Key>> ascending = records, descending = records, stable = records;
+	std::stable_sort(stable.begin(), stable.end(), by_key);
+
+	scandum::crumsort(ascending.begin(), ascending.end(), std::less<>(), &Record<Key>::key);
+	scandum::quadsort(descending.begin(), descending.end(), std::greater<Key>(), [](const Record<Key>& record) { return record.key; });
+
+	CHECK(std::is_sorted(ascending.begin(), ascending.end(), by_key));
+	CHECK(std::is_sorted(descending.begin(), descending.end(), by_key_descending));
+
+	for (auto& record : ascending) CHECK(record.payload[0] == record.order);
+
+	std::deque<Record<Key>> stable_deque(records.begin(), records.end());
+	scandum::quadsort(stable_deque.begin(), stable_deque.end(), std::less<Key>(), &Record<Key>::key);
+
+	for (size_t i = 0; i < stable.size(); ++i) CHECK(stable_deque[i].order == stable[i].order);
+
+	for (size_t i = 1; i < descending.size(); ++i) {
+		if (descending[i].key == descending[i - 1].key) CHECK(descending[i].order > descending[i - 1].order);
+	}
+}
+
+TEST_CASE("crumsort and quadsort sort by a projection") {
+	for (int size : { 100, 1000, 100000 }) {
+		for (int distinct : { 10, 1000000 }) {
+			CheckProjectedSorts<std::int8_t>(size, 100);
+			CheckProjectedSorts<std::int32_t>(size, distinct);
+			CheckProjectedSorts<std::uint32_t>(size, distinct);
+			CheckProjectedSorts<std::int64_t>(size, distinct);
+			CheckProjectedSorts<float>(size, distinct);
+			CheckProjectedSorts<double>(size, distinct);
+		}
+	}
+}
+
+TEST_CASE("quadsort keeps keys of 0.0 and -0.0 in order when sorting by a projection") {
+	std::vector<Record<float>> records;
+	for (int i = 0; i < 1000; ++i) records.push_back({ RandomInt(2) ? 0.0f : -0.0f, i, { 0, 0 } });
+
+	scandum::quadsort(records.begin(), records.end(), std::less<>(), &Record<float>::key);
+
+	for (int i = 0; i < 1000; ++i) CHECK(records[i].order == i);
+}
+
+TEST_CASE("crumsort sorts by a projection with a three-way comparison") {
+	std::vector<std::string> names;
+	for (int i = 0; i < 1000; ++i) names.push_back(std::to_string(RandomInt(100000)));
+
+	scandum::crumsort(names.begin(), names.end(), [](std::size_t a, std::size_t b) { return (a > b) - (a < b); }, [](const std::string& name) { return name.size(); });
+
+	CHECK(std::is_sorted(names.begin(), names.end(), [](const std::string& a, const std::string& b) { return a.size() < b.size(); }));
+}
+
+//////
+// String sort
+//////
+
+// strings of a few letters, including one above 0x7f, after a prefix of up to
+// 20 shared bytes, so that prefixes both differ and tie
+std::string RandomString(bool nul) {
+	std::string str(RandomInt(3) * 10, 'p');
+	int length = RandomInt(12);
+	for (int i = 0; i < length; ++i) str += "ab\xe9"[RandomInt(3)];
+	if (nul && RandomInt(4) == 0) str += std::string(RandomInt(3), '\0');
+	return str;
+}
+
+TEST_CASE("string_sort sorts std::string, std::string_view and C strings") {
+	for (int size : { 10, 100, 1000, 100000 }) {
+		std::vector<std::string> strings;
+		for (int i = 0; i < size; ++i) strings.push_back(RandomString(true));
+
+		std::vector<std::string> sorted = strings;
+		std::sort(sorted.begin(), sorted.end());
+
+		std::vector<std::string_view> views(strings.begin(), strings.end());
+		std::vector<const char*> c_strings;
+		for (auto& str : strings) c_strings.push_back(str.c_str());
+
+		std::vector<std::string> copies = strings;
+
+		scandum::string_sort(copies.begin(), copies.end());
+		scandum::string_sort(views.begin(), views.end());
+		scandum::string_sort(c_strings.begin(), c_strings.end());
+
+		CHECK(copies == sorted);
+		CHECK(std::equal(views.begin(), views.end(), sorted.begin(), sorted.end()));
+
+		std::vector<std::string> truncated;
+		for (auto& str : sorted) truncated.push_back(str.c_str());
+		std::sort(truncated.begin(), truncated.end());
+
+		CHECK(std::equal(c_strings.begin(), c_strings.end(), truncated.begin(), truncated.end()));
+	}
+}
+
+TEST_CASE("string_sort sorts strings that share long prefixes") {
+	std::vector<std::string> strings;
+	for (int i = 0; i < 100000; ++i) strings.push_back("https://example.com/" + std::string(RandomInt(3) * 40, 'a') + std::to_string(RandomInt(1000)) + (RandomInt(2) ? "/" : ""));
+
+	std::vector<std::string> sorted = strings;
+	std::sort(sorted.begin(), sorted.end());
+
+	std::vector<const char*> c_strings;
+	for (auto& str : strings) c_strings.push_back(str.c_str());
+
+	scandum::string_sort(c_strings.begin(), c_strings.end());
+	scandum::string_sort(strings.begin(), strings.end());
+
+	CHECK(strings == sorted);
+	CHECK(std::equal(c_strings.begin(), c_strings.end(), sorted.begin(), sorted.end()));
+}
+
+TEST_CASE("string_sort orders strings that differ only in trailing NULs by their length") {
+	std::vector<std::string> strings;
+	for (int i = 0; i < 1000; ++i) strings.push_back(std::string("abcdefgh", RandomInt(9)) + std::string(RandomInt(10), '\0'));
+
+	std::vector<std::string> sorted = strings;
+	std::sort(sorted.begin(), sorted.end());
+
+	scandum::string_sort(strings.begin(), strings.end());
+
+	CHECK(strings == sorted);
+}
+
 //////
 // Nontrivial default constructor
 //////
@@ -295,3 +494,816 @@ TEST_CASE("quadsort sorts types with noncontiguous memory") {
 
 	CHECK(std::is_sorted(list.begin(), list.end()));
 }
+
+//////
+// Caller supplied scratch memory
+//////
+
+TEST_CASE("crumsort sorts with caller supplied scratch memory") {
+	std::vector<int> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(RandomInt());
+
+	std::vector<unsigned char> scratch(scandum::crumsort_scratch_size<int>(list.size()));
+	scandum::crumsort(list.begin(), list.end(), std::less<int>(), scratch.data(), scratch.size());
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+}
+
+TEST_CASE("quadsort sorts with caller supplied scratch memory") {
+	std::vector<int> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(RandomInt());
+
+	std::vector<unsigned char> scratch(scandum::quadsort_scratch_size<int>(list.size()));
+	scandum::quadsort(list.begin(), list.end(), std::less<int>(), scratch.data(), scratch.size());
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+}
+
+TEST_CASE("quadsort is stable with undersized scratch memory") {
+	constexpr int MAX_VALUE = 10;
+
+	std::vector<OrderedInt> list;
+	for (int i = 0; i < 1000; ++i) list.push_back({ RandomInt(MAX_VALUE), i });
+
+	unsigned char scratch[40 * sizeof(OrderedInt)];
+	scandum::quadsort(list.begin(), list.end(), std::less<OrderedInt>(), scratch + 1, sizeof(scratch) - 1);
+
+	CHECK(std::is_sorted(list.begin(), list.end(), [](const auto& a, const auto& b){
+		return (a.value * 10000) + a.order < (b.value * 10000) + b.order;
+	}));
+}
+
+TEST_CASE("crumsort sorts types without a default constructor with caller supplied scratch memory") {
+	std::vector<NoDefaultConstructor> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(NoDefaultConstructor(RandomInt()));
+
+	std::vector<unsigned char> scratch(scandum::crumsort_scratch_size<NoDefaultConstructor>(list.size()));
+	scandum::crumsort(list.begin(), list.end(), std::less<NoDefaultConstructor>(), scratch.data(), scratch.size());
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+}
+
+//////
+// Custom allocators
+//////
+
+template<typename T>
+struct CountingAllocator {
+	using value_type = T;
+
+	size_t* allocated;
+
+	explicit CountingAllocator(size_t* allocated) : allocated(allocated) {}
+	template<typename U>
+	CountingAllocator(const CountingAllocator<U>& other) : allocated(other.allocated) {}
+
+	T* allocate(size_t n) { *allocated += n * sizeof(T); return std::allocator<T>().allocate(n); }
+	void deallocate(T* p, size_t n) { std::allocator<T>().deallocate(p, n); }
+};
+
+TEST_CASE("crumsort allocates scratch memory with a custom allocator") {
+	std::vector<int> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(RandomInt());
+
+	size_t allocated = 0;
+	scandum::crumsort(list.begin(), list.end(), std::less<int>(), CountingAllocator<int>(&allocated));
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(allocated >= 512 * sizeof(int));
+}
+
+TEST_CASE("quadsort allocates scratch memory with a custom allocator") {
+	std::vector<NoDefaultConstructor> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(NoDefaultConstructor(RandomInt()));
+
+	size_t allocated = 0;
+	scandum::quadsort(list.begin(), list.end(), std::less<NoDefaultConstructor>(), CountingAllocator<char>(&allocated));
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(allocated >= 1000 * sizeof(NoDefaultConstructor));
+}
+
+#ifdef __cpp_lib_memory_resource
+TEST_CASE("crumsort and quadsort allocate scratch memory from a memory resource") {
+	std::vector<std::string> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(std::to_string(RandomInt()));
+	std::vector<std::string> copy = list;
+
+	unsigned char buffer[64 * 1024];
+	std::pmr::monotonic_buffer_resource local(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+	scandum::crumsort(list.begin(), list.end(), std::less<std::string>(), &local);
+	scandum::quadsort(copy.begin(), copy.end(), std::less<std::string>(), &local);
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(std::is_sorted(copy.begin(), copy.end()));
+}
+#endif
+
+//////
+// Huge pages
+//////
+
+TEST_CASE("crumsort and quadsort sort with huge page backed scratch memory") {
+	// large enough that quadsort's scratch memory spans more than one huge page
+	std::vector<long long> list;
+	for (int i = 0; i < 600000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<long long> copy = list;
+
+	scandum::crumsort(list.begin(), list.end(), std::less<long long>(), scandum::huge_page_allocator<long long>(), list.size());
+	scandum::quadsort(copy.begin(), copy.end(), std::less<long long>(), scandum::huge_page_allocator<long long>(true));
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(list == copy);
+}
+
+TEST_CASE("huge_page_allocator allocates blocks below and above the huge page size") {
+	scandum::huge_page_allocator<int> allocator;
+
+	int* small = allocator.allocate(100);
+	int* large = allocator.allocate(scandum::huge_page_allocator<int>::page_size);
+
+	small[99] = 1;
+	large[scandum::huge_page_allocator<int>::page_size - 1] = 1;
+#if defined(__unix__) || defined(__APPLE__)
+	CHECK(reinterpret_cast<uintptr_t>(large) % scandum::huge_page_allocator<int>::page_size == 0);
+#endif
+
+	allocator.deallocate(small, 100);
+	allocator.deallocate(large, scandum::huge_page_allocator<int>::page_size);
+}
+
+//////
+// Scratch budget
+//////
+
+TEST_CASE("quadsort stays within its scratch budget and is stable") {
+	constexpr int MAX_VALUE = 10;
+
+	std::vector<OrderedInt> unsorted;
+	for (int i = 0; i < 5000; ++i) unsorted.push_back({ RandomInt(MAX_VALUE), i });
+
+	for (size_t limit : { size_t(0), 32 * sizeof(OrderedInt), 100 * sizeof(OrderedInt), 2000 * sizeof(OrderedInt), std::numeric_limits<size_t>::max() }) {
+		std::vector<OrderedInt> list = unsorted;
+
+		scandum::scratch_budget budget;
+		budget.limit = limit;
+		scandum::quadsort(list.begin(), list.end(), std::less<OrderedInt>(), budget);
+
+		CHECK(std::is_sorted(list.begin(), list.end(), [](const auto& a, const auto& b){
+			return (a.value * 10000) + a.order < (b.value * 10000) + b.order;
+		}));
+		CHECK(budget.peak <= std::max(limit, 32 * sizeof(OrderedInt)));
+		CHECK(budget.peak >= 32 * sizeof(OrderedInt));
+	}
+}
+
+TEST_CASE("quadsort reports its peak scratch usage") {
+	std::vector<int> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(RandomInt());
+
+	scandum::scratch_budget budget;
+	scandum::quadsort(list.begin(), list.end(), std::less<int>(), budget);
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(budget.peak == 1000 * sizeof(int));
+}
+
+//////
+// Small sorts on the stack
+//////
+
+struct LargerThanStack {
+	int value;
+	char padding[1020];
+
+	bool operator<(const LargerThanStack& other) const { return value < other.value; }
+};
+
+TEST_CASE("crumsort sorts small arrays of types too large for the stack") {
+	std::vector<LargerThanStack> list;
+	for (int i = 0; i < 200; ++i) list.push_back({ RandomInt(), {} });
+
+	scandum::crumsort(list.begin(), list.end());
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+}
+
+TEST_CASE("quadsort sorts small arrays of types too large for the stack") {
+	std::vector<LargerThanStack> list;
+	for (int i = 0; i < 31; ++i) list.push_back({ RandomInt(), {} });
+
+	scandum::quadsort(list.begin(), list.end());
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+}
+
+struct ThrowingMove {
+	int value;
+
+	explicit ThrowingMove(int value) : value(value) {}
+	ThrowingMove(ThrowingMove&& other) noexcept(false) : value(other.value) {}
+	ThrowingMove& operator=(ThrowingMove&& other) noexcept(false) { value = other.value; return *this; }
+
+	bool operator<(const ThrowingMove& other) const noexcept { return value < other.value; }
+};
+
+TEST_CASE("crumsort and quadsort are noexcept when moving and comparing are") {
+	std::vector<int> ints;
+	std::vector<ThrowingMove> throwing;
+	std::vector<LargerThanStack> large;
+
+	CHECK(noexcept(scandum::crumsort(ints.begin(), ints.end())));
+	CHECK(noexcept(scandum::quadsort(ints.begin(), ints.end())));
+	CHECK(noexcept(scandum::crumsort(ints.begin(), ints.end(), std::greater<int>())));
+	CHECK(noexcept(scandum::quadsort(ints.begin(), ints.end(), std::greater<int>())));
+
+	CHECK(!noexcept(scandum::crumsort(throwing.begin(), throwing.end())));
+	CHECK(!noexcept(scandum::quadsort(throwing.begin(), throwing.end())));
+
+	CHECK(!noexcept(scandum::crumsort(large.begin(), large.end())));
+	CHECK(!noexcept(scandum::quadsort(large.begin(), large.end())));
+
+	auto throwing_cmp = [](int a, int b) { return a < b; };
+	auto nothrow_cmp = [](int a, int b) noexcept { return a < b; };
+
+	CHECK(!noexcept(scandum::crumsort(ints.begin(), ints.end(), throwing_cmp)));
+	CHECK(noexcept(scandum::crumsort(ints.begin(), ints.end(), nothrow_cmp)));
+
+	auto nothrow_three_way = [](int a, int b) noexcept { return (a > b) - (a < b); };
+
+	CHECK(noexcept(scandum::quadsort(ints.begin(), ints.end(), nothrow_three_way)));
+}
+
+//////
+// Scratch arena
+//////
+
+TEST_CASE("crumsort and quadsort keep scratch memory in the thread's arena") {
+	scandum::set_scratch_arena_limit(1 << 20);
+
+	for (int pass = 0; pass < 3; ++pass) {
+		std::vector<int> list;
+		for (int i = 0; i < 10000; ++i) list.push_back(RandomInt());
+		std::vector<int> copy = list;
+
+		scandum::crumsort(list.begin(), list.end());
+		scandum::quadsort(copy.begin(), copy.end());
+
+		CHECK(std::is_sorted(list.begin(), list.end()));
+		CHECK(std::is_sorted(copy.begin(), copy.end()));
+		CHECK(scandum::scratch_arena_size() > 0);
+		CHECK(scandum::scratch_arena_size() <= 1 << 20);
+	}
+
+	scandum::set_scratch_arena_limit(0);
+
+	CHECK(scandum::scratch_arena_size() == 0);
+}
+
+TEST_CASE("trim_scratch_arena frees the thread's arena") {
+	scandum::set_scratch_arena_limit(1 << 20);
+
+	std::vector<NoDefaultConstructor> list;
+	for (int i = 0; i < 1000; ++i) list.push_back(NoDefaultConstructor(RandomInt()));
+
+	scandum::quadsort(list.begin(), list.end(), std::less<NoDefaultConstructor>());
+
+	CHECK(scandum::scratch_arena_size() > 0);
+
+	scandum::trim_scratch_arena();
+
+	CHECK(scandum::scratch_arena_size() == 0);
+
+	std::reverse(list.begin(), list.end());
+	scandum::crumsort(list.begin(), list.end(), std::less<NoDefaultConstructor>());
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+
+	scandum::set_scratch_arena_limit(0);
+}
+
+//////
+// Resource owning types
+//////
+
+TEST_CASE("crumsort sorts strings without losing any") {
+	std::vector<std::string> list;
+	for (int i = 0; i < 5000; ++i) list.push_back(std::to_string(RandomInt(100000)));
+
+	std::vector<std::string> expected = list;
+	std::sort(expected.begin(), expected.end());
+
+	scandum::crumsort(list.begin(), list.end());
+
+	CHECK(list == expected);
+}
+
+TEST_CASE("quadsort sorts strings without losing any") {
+	std::vector<std::string> list;
+	for (int i = 0; i < 5000; ++i) list.push_back(std::to_string(RandomInt(100000)));
+
+	std::vector<std::string> expected = list;
+	std::stable_sort(expected.begin(), expected.end());
+
+	scandum::quadsort(list.begin(), list.end());
+
+	CHECK(list == expected);
+}
+
+struct UniqueInt {
+	std::unique_ptr<int> value;
+
+	explicit UniqueInt(int value) : value(new int(value)) {}
+
+	bool operator<(const UniqueInt& other) const { return *value < *other.value; }
+};
+
+static_assert (!std::is_default_constructible_v<UniqueInt>);
+static_assert (!std::is_copy_constructible_v<UniqueInt>);
+
+TEST_CASE("crumsort sorts move-only types without a default constructor") {
+	std::vector<UniqueInt> list;
+	for (int i = 0; i < 5000; ++i) list.push_back(UniqueInt(RandomInt()));
+
+	scandum::crumsort(list.begin(), list.end());
+
+	CHECK(std::all_of(list.begin(), list.end(), [](const auto& x){ return x.value != nullptr; }));
+	CHECK(std::is_sorted(list.begin(), list.end()));
+}
+
+TEST_CASE("quadsort sorts move-only types without a default constructor") {
+	std::vector<UniqueInt> list;
+	for (int i = 0; i < 5000; ++i) list.push_back(UniqueInt(RandomInt()));
+
+	scandum::quadsort(list.begin(), list.end());
+
+	CHECK(std::all_of(list.begin(), list.end(), [](const auto& x){ return x.value != nullptr; }));
+	CHECK(std::is_sorted(list.begin(), list.end()));
+}
+
+//////
+// Parallel sorting
+//////
+
+TEST_CASE("parallel_crumsort sorts on several threads") {
+	std::vector<long long> list;
+	for (int i = 0; i < 300000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<long long> copy = list;
+
+	scandum::parallel_crumsort(list.begin(), list.end(), std::less<long long>(), 4);
+	std::sort(copy.begin(), copy.end());
+
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel_crumsort partitions large arrays with few distinct values on several threads") {
+	std::vector<std::string> list;
+	for (int i = 0; i < 400000; ++i) list.push_back(std::to_string(RandomInt(8)));
+	std::vector<std::string> copy = list;
+
+	scandum::parallel_crumsort(list.begin(), list.end(), std::less<std::string>(), 4);
+	std::sort(copy.begin(), copy.end());
+
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel_crumsort sorts types with noncontiguous memory") {
+	std::deque<std::string> list;
+	for (int i = 0; i < 100000; ++i) list.push_back(std::to_string(RandomInt(100000)));
+	std::deque<std::string> copy = list;
+
+	scandum::parallel_crumsort(list.begin(), list.end(), std::greater<std::string>(), 3);
+	std::sort(copy.begin(), copy.end(), std::greater<std::string>());
+
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel_crumsort rethrows exceptions from the comparison") {
+	std::vector<int> list;
+	for (int i = 0; i < 300000; ++i) list.push_back(RandomInt(1000000));
+
+	std::atomic<int> comparisons { 0 };
+	auto cmp = [&](int lhs, int rhs) {
+		if (++comparisons == 1000000) throw std::runtime_error("comparison failed");
+		return lhs < rhs;
+	};
+
+	CHECK_THROWS_AS(scandum::parallel_crumsort(list.begin(), list.end(), cmp, 4), std::runtime_error);
+}
+
+TEST_CASE("parallel_quadsort is stable on several threads") {
+	constexpr int MAX_VALUE = 100;
+
+	std::vector<OrderedInt> list;
+	for (int i = 0; i < 600000; ++i) list.push_back({ RandomInt(MAX_VALUE), i });
+
+	scandum::parallel_quadsort(list.begin(), list.end(), std::less<OrderedInt>(), 4);
+
+	CHECK(std::is_sorted(list.begin(), list.end(), [](const auto& a, const auto& b){
+		return a.value < b.value || (a.value == b.value && a.order < b.order);
+	}));
+}
+
+TEST_CASE("parallel_quadsort sorts strings without losing any") {
+	std::vector<std::string> list;
+	for (int i = 0; i < 300000; ++i) list.push_back(std::to_string(RandomInt(100000)));
+	std::vector<std::string> copy = list;
+
+	scandum::parallel_quadsort(list.begin(), list.end(), std::less<std::string>(), 2);
+	std::stable_sort(copy.begin(), copy.end());
+
+	CHECK(list == copy);
+}
+
+TEST_CASE("crumsort and quadsort take execution policies") {
+	std::vector<int> list;
+	for (int i = 0; i < 300000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<int> copy = list;
+
+	scandum::crumsort(std::execution::par, list.begin(), list.end());
+	scandum::quadsort(std::execution::par_unseq, copy.begin(), copy.end(), std::greater<int>());
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(std::is_sorted(copy.begin(), copy.end(), std::greater<int>()));
+
+	scandum::crumsort(std::execution::seq, list.begin(), list.end(), std::greater<int>());
+
+	CHECK(list == copy);
+}
+
+struct InlineBackend : scandum::parallel_backend {
+	int runs = 0;
+
+	size_t concurrency() const override { return 4; }
+
+	void run(size_t workers, const std::function<void(size_t)>& body) override {
+		++runs;
+		for (size_t worker = 0; worker < workers; ++worker) body(worker);
+	}
+};
+
+TEST_CASE("parallel sorts run on a custom backend") {
+	std::vector<long long> list;
+	for (int i = 0; i < 600000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<long long> copy = list;
+
+	InlineBackend backend;
+	scandum::set_parallel_backend(&backend);
+
+	scandum::parallel_crumsort(list.begin(), list.end());
+	scandum::quadsort(std::execution::par, copy.begin(), copy.end());
+
+	scandum::set_parallel_backend(nullptr);
+
+	CHECK(backend.runs == 2);
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel sorts run on a thread_executor") {
+	std::vector<std::string> list;
+	for (int i = 0; i < 200000; ++i) list.push_back(std::to_string(RandomInt(1000000)));
+	std::vector<std::string> copy = list;
+
+	scandum::thread_executor executor(3);
+
+	scandum::parallel_crumsort(executor, list.begin(), list.end(), std::less<std::string>(), 1000);
+	scandum::parallel_quadsort(executor, copy.begin(), copy.end(), std::less<std::string>(), 1000);
+
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(list == copy);
+}
+
+struct CountingExecutor {
+	using task_group = scandum::inline_executor::task_group;
+
+	int submits = 0;
+
+	size_t concurrency() const { return 4; }
+	void submit(task_group&, const std::function<void()>& task) { ++submits; task(); }
+	void wait(task_group&) {}
+};
+
+TEST_CASE("parallel sorts submit nothing for arrays within the grain") {
+	std::vector<int> list;
+	for (int i = 0; i < 5000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<int> copy = list;
+
+	CountingExecutor executor;
+
+	scandum::parallel_crumsort(executor, list.begin(), list.end(), std::less<int>(), 5000);
+	scandum::parallel_quadsort(executor, copy.begin(), copy.end(), std::less<int>(), 5000);
+
+	CHECK(executor.submits == 0);
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(list == copy);
+
+	scandum::inline_executor serial;
+	std::reverse(list.begin(), list.end());
+
+	scandum::parallel_crumsort(serial, list.begin(), list.end());
+
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel sorts finish on an executor that runs tasks on submission") {
+	std::vector<int> list;
+	for (int i = 0; i < 100000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<int> copy = list;
+
+	CountingExecutor executor;
+
+	scandum::parallel_crumsort(executor, list.begin(), list.end(), std::less<int>(), 1000);
+	scandum::parallel_quadsort(executor, copy.begin(), copy.end(), std::less<int>(), 1000);
+
+	CHECK(executor.submits == 6);
+	CHECK(std::is_sorted(list.begin(), list.end()));
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel_samplesort sorts on several threads") {
+	std::vector<long long> list;
+	for (int i = 0; i < 600000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<long long> copy = list;
+
+	scandum::parallel_samplesort(list.begin(), list.end(), std::less<long long>(), 4);
+	std::sort(copy.begin(), copy.end());
+
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel_samplesort sorts few distinct values in buckets of their own") {
+	std::vector<std::string> list;
+	for (int i = 0; i < 200000; ++i) list.push_back(std::to_string(RandomInt(20)));
+	std::vector<std::string> copy = list;
+
+	scandum::thread_executor executor(4);
+
+	scandum::parallel_samplesort(executor, list.begin(), list.end(), std::greater<std::string>(), 1000);
+	std::sort(copy.begin(), copy.end(), std::greater<std::string>());
+
+	CHECK(list == copy);
+}
+
+TEST_CASE("parallel sorts sort with NUMA placement on or off") {
+	std::vector<long long> list;
+	for (int i = 0; i < 400000; ++i) list.push_back(RandomInt(1000000));
+	std::vector<long long> copy = list;
+
+	bool available = scandum::set_numa_placement(false);
+
+	CHECK(!available);
+	CHECK(!scandum::numa_placement());
+
+	scandum::parallel_crumsort(list.begin(), list.end(), std::less<long long>(), 4);
+
+	available = scandum::set_numa_placement(true);
+
+	CHECK(scandum::numa_placement() == available);
+
+	scandum::parallel_samplesort(copy.begin(), copy.end(), std::less<long long>(), 4);
+
+	CHECK(list == copy);
+}
+
+//////
+// Primitive keys
+//////
+
+TEST_CASE("crumsort_prim sorts integers and floating point numbers") {
+	std::vector<long long> longs;
+	for (int i = 0; i < 1500000; ++i) longs.push_back(RandomInt(1000000) - 500000);
+	std::vector<long long> sorted_longs = longs;
+
+	std::vector<float> floats;
+	for (int i = 0; i < 5000; ++i) floats.push_back(RandomInt(1000) / 8.0f);
+	std::vector<float> sorted_floats = floats;
+
+	scandum::crumsort_prim(longs.begin(), longs.end());
+	scandum::crumsort_prim(floats.begin(), floats.end());
+	std::sort(sorted_longs.begin(), sorted_longs.end());
+	std::sort(sorted_floats.begin(), sorted_floats.end());
+
+	CHECK(longs == sorted_longs);
+	CHECK(floats == sorted_floats);
+	CHECK(noexcept(scandum::crumsort_prim(longs.begin(), longs.end())));
+}
+
+TEST_CASE("quadsort_prim sorts integers and floating point numbers") {
+	std::vector<unsigned char> bytes;
+	for (int i = 0; i < 1500000; ++i) bytes.push_back(static_cast<unsigned char>(RandomInt(255)));
+	std::vector<unsigned char> sorted_bytes = bytes;
+
+	std::deque<double> doubles;
+	for (int i = 0; i < 5000; ++i) doubles.push_back(RandomInt(1000) / 8.0);
+	std::deque<double> sorted_doubles = doubles;
+
+	scandum::quadsort_prim(bytes.begin(), bytes.end());
+	scandum::quadsort_prim(doubles.begin(), doubles.end());
+	std::sort(sorted_bytes.begin(), sorted_bytes.end());
+	std::sort(sorted_doubles.begin(), sorted_doubles.end());
+
+	CHECK(bytes == sorted_bytes);
+	CHECK(doubles == sorted_doubles);
+}
+
+TEST_CASE("crumsort and quadsort sort with std::less and std::greater on primitive kernels") {
+	std::vector<int> ints;
+	for (int i = 0; i < 100000; ++i) ints.push_back(RandomInt(1000));
+	std::vector<int> ascending = ints, descending = ints;
+	std::sort(ascending.begin(), ascending.end());
+	std::sort(descending.begin(), descending.end(), std::greater<int>());
+
+	std::vector<int> crum_less = ints, crum_greater = ints, quad_less = ints, quad_greater = ints;
+	std::deque<int> deque_greater(ints.begin(), ints.end());
+
+	scandum::crumsort(crum_less.data(), crum_less.data() + crum_less.size(), std::less<>());
+	scandum::crumsort(crum_greater.begin(), crum_greater.end(), std::greater<int>());
+	scandum::quadsort(quad_less.begin(), quad_less.end(), std::less<int>());
+	scandum::quadsort(quad_greater.begin(), quad_greater.end(), std::greater<>());
+	scandum::quadsort(deque_greater.begin(), deque_greater.end(), std::greater<int>());
+
+	CHECK(crum_less == ascending);
+	CHECK(crum_greater == descending);
+	CHECK(quad_less == ascending);
+	CHECK(quad_greater == descending);
+	CHECK(std::equal(deque_greater.begin(), deque_greater.end(), descending.begin(), descending.end()));
+}
+
+template<typename T>
+void CheckPrimitivePartitions(int distinct) {
+	for (int size : { 97, 1000, 5000, 100000 }) {
+		std::vector<T> ascending, descending;
+		for (int i = 0; i < size; ++i) ascending.push_back(static_cast<T>(RandomInt(distinct) - distinct / 2) * static_cast<T>(3));
+		descending = ascending;
+
+		std::vector<T> sorted_ascending = ascending, sorted_descending = descending;
+		std::sort(sorted_ascending.begin(), sorted_ascending.end());
+		std::sort(sorted_descending.begin(), sorted_descending.end(), std::greater<T>());
+
+		scandum::crumsort(ascending.begin(), ascending.end(), std::less<T>());
+		scandum::crumsort(descending.begin(), descending.end(), std::greater<T>());
+
+		CHECK(ascending == sorted_ascending);
+		CHECK(descending == sorted_descending);
+	}
+}
+
+TEST_CASE("crumsort partitions 32 and 64 bit keys") {
+	for (int distinct : { 2, 16, 1000000 }) {
+		CheckPrimitivePartitions<std::int32_t>(distinct);
+		CheckPrimitivePartitions<std::uint32_t>(distinct);
+		CheckPrimitivePartitions<std::int64_t>(distinct);
+		CheckPrimitivePartitions<std::uint64_t>(distinct);
+		CheckPrimitivePartitions<float>(distinct);
+		CheckPrimitivePartitions<double>(distinct);
+	}
+}
+
+// crumsort picks quadsort for the quarters of an array it finds in order and
+// reverses those in reverse order, scanning them with vector compares
+
+template<typename T>
+void CheckPrimitiveQuarters() {
+	for (int size : { 1000, 33333 }) {
+		for (int pattern = 0; pattern < 81; ++pattern) {
+			std::vector<T> keys;
+			for (int quarter = 0, order = pattern; quarter < 4; ++quarter, order /= 3) {
+				std::vector<T> part;
+				for (int i = 0; i < (size + quarter) / 4; ++i) part.push_back(static_cast<T>(RandomInt(1000) - 500));
+				if (order % 3 == 1) std::sort(part.begin(), part.end());
+				if (order % 3 == 2) std::sort(part.begin(), part.end(), std::greater<T>());
+				keys.insert(keys.end(), part.begin(), part.end());
+			}
+
+			std::vector<T> sorted_ascending = keys, sorted_descending = keys;
+			std::sort(sorted_ascending.begin(), sorted_ascending.end());
+			std::sort(sorted_descending.begin(), sorted_descending.end(), std::greater<T>());
+
+			std::vector<T> ascending = keys, descending = keys;
+			scandum::crumsort(ascending.begin(), ascending.end(), std::less<T>());
+			scandum::crumsort(descending.begin(), descending.end(), std::greater<T>());
+			CHECK(ascending == sorted_ascending);
+			CHECK(descending == sorted_descending);
+		}
+	}
+}
+
+TEST_CASE("crumsort sorts 32 and 64 bit keys in ordered and reversed quarters") {
+	CheckPrimitiveQuarters<std::int32_t>();
+	CheckPrimitiveQuarters<std::uint32_t>();
+	CheckPrimitiveQuarters<std::int64_t>();
+	CheckPrimitiveQuarters<std::uint64_t>();
+	CheckPrimitiveQuarters<float>();
+	CheckPrimitiveQuarters<double>();
+}
+
+template<typename T>
+void CheckPrimitiveNetworks(int distinct) {
+	for (int size = 0; size <= 100; ++size) {
+		std::vector<T> keys;
+		for (int i = 0; i < size; ++i) keys.push_back(static_cast<T>(RandomInt(distinct) - distinct / 2) * static_cast<T>(3));
+
+		std::vector<T> sorted_ascending = keys, sorted_descending = keys;
+		std::sort(sorted_ascending.begin(), sorted_ascending.end());
+		std::sort(sorted_descending.begin(), sorted_descending.end(), std::greater<T>());
+
+		std::vector<T> ascending = keys, descending = keys;
+		scandum::quadsort(ascending.begin(), ascending.end(), std::less<T>());
+		scandum::quadsort(descending.begin(), descending.end(), std::greater<T>());
+		CHECK(ascending == sorted_ascending);
+		CHECK(descending == sorted_descending);
+
+		ascending = keys, descending = keys;
+		scandum::crumsort(ascending.begin(), ascending.end(), std::less<T>());
+		scandum::crumsort(descending.begin(), descending.end(), std::greater<T>());
+		CHECK(ascending == sorted_ascending);
+		CHECK(descending == sorted_descending);
+	}
+}
+
+TEST_CASE("crumsort and quadsort sort small arrays of 32 and 64 bit keys") {
+	for (int distinct : { 2, 16, 1000000 }) {
+		CheckPrimitiveNetworks<std::int32_t>(distinct);
+		CheckPrimitiveNetworks<std::uint32_t>(distinct);
+		CheckPrimitiveNetworks<std::int64_t>(distinct);
+		CheckPrimitiveNetworks<std::uint64_t>(distinct);
+		CheckPrimitiveNetworks<float>(distinct);
+		CheckPrimitiveNetworks<double>(distinct);
+	}
+}
+
+template<typename T>
+void CheckPrimitiveMerges(int distinct, size_t scratch_keys) {
+	for (int size : { 300, 1000, 4100, 100000 }) {
+		std::vector<T> keys;
+		for (int i = 0; i < size; ++i) keys.push_back(static_cast<T>(RandomInt(distinct) - distinct / 2) * static_cast<T>(3));
+		std::sort(keys.begin(), keys.begin() + size / 3);
+
+		std::vector<T> sorted_ascending = keys, sorted_descending = keys;
+		std::sort(sorted_ascending.begin(), sorted_ascending.end());
+		std::sort(sorted_descending.begin(), sorted_descending.end(), std::greater<T>());
+
+		std::vector<unsigned char> scratch(scratch_keys ? scratch_keys * sizeof(T) : scandum::quadsort_scratch_size<T>(keys.size()));
+		std::vector<T> ascending = keys, descending = keys;
+		scandum::quadsort(ascending.begin(), ascending.end(), std::less<T>(), scratch.data(), scratch.size());
+		scandum::quadsort(descending.begin(), descending.end(), std::greater<T>(), scratch.data(), scratch.size());
+
+		CHECK(ascending == sorted_ascending);
+		CHECK(descending == sorted_descending);
+	}
+}
+
+TEST_CASE("quadsort merges 32 and 64 bit keys with any amount of scratch memory") {
+	for (size_t scratch_keys : { 0, 100, 512, 3000 }) {
+		CheckPrimitiveMerges<std::int32_t>(1000000, scratch_keys);
+		CheckPrimitiveMerges<std::uint32_t>(16, scratch_keys);
+		CheckPrimitiveMerges<std::int64_t>(1000000, scratch_keys);
+		CheckPrimitiveMerges<std::uint64_t>(1000000, scratch_keys);
+	}
+}
+
+TEST_CASE("quadsort keeps 0.0 and -0.0 in order in small arrays") {
+	for (int size : { 8, 16, 32, 64 }) {
+		std::vector<double> zeros, stable;
+		for (int i = 0; i < size; ++i) zeros.push_back(RandomInt(2) ? 0.0 : -0.0);
+		stable = zeros;
+
+		scandum::quadsort(zeros.begin(), zeros.end(), std::less<double>());
+
+		for (int i = 0; i < size; ++i) CHECK(std::signbit(zeros[i]) == std::signbit(stable[i]));
+	}
+}
+
+template<typename T>
+void CheckPrimitiveSorts() {
+	for (int size : { 60, 100000 }) {
+		std::vector<T> keys;
+		for (int i = 0; i < size; ++i) keys.push_back(static_cast<T>(RandomInt(1000000) - 500000));
+
+		std::vector<T> sorted = keys;
+		std::sort(sorted.begin(), sorted.end());
+
+		std::vector<T> crum = keys, quad = keys;
+		scandum::crumsort(crum.begin(), crum.end(), std::less<T>());
+		scandum::quadsort(quad.begin(), quad.end(), std::less<T>());
+		CHECK(crum == sorted);
+		CHECK(quad == sorted);
+	}
+}
+
+TEST_CASE("crumsort and quadsort sort primitive keys with the kernels capped at each instruction set") {
+	scandum::simd_isa widest = scandum::set_simd_isa(scandum::simd_isa::avx512);
+	CHECK(scandum::current_simd_isa() == widest);
+
+	for (scandum::simd_isa isa : { scandum::simd_isa::scalar, scandum::simd_isa::avx2, scandum::simd_isa::avx512 }) {
+		scandum::simd_isa used = scandum::set_simd_isa(isa);
+		CHECK(used == (isa < widest ? isa : widest));
+		CHECK(scandum::current_simd_isa() == used);
+
+		CheckPrimitiveSorts<std::int32_t>();
+		CheckPrimitiveSorts<std::int64_t>();
+		CheckPrimitiveSorts<double>();
+	}
+}